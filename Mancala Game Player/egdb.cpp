@@ -0,0 +1,156 @@
+// builds the endgame database that solve.cpp loads with --egdb: the exact
+// result of every position with at most N gems left in the pits.
+//
+// usage: egdb [N] [file], 16 and endgame.db by default
+//
+// gems never leave a store, so how a position ends only depends on the 12
+// pits and who is to move; the stores just add on. and the rules are the
+// same for both players, so positions are kept from the side to move: its 6
+// pits first, then the opponent's. the value of a position is how many more
+// of the gems left in the pits the side to move ends up with than the
+// opponent, with both playing their best.
+//
+// the positions are solved by the number of gems left, fewest first. a
+// move either puts gems in a store, and leads to a position already solved,
+// or only moves gems along the side they are on, towards its store. so the
+// positions within a level never lead back to each other, and the rest of
+// a level is solved on the way.
+//
+// file: "MANCALA\0", N as uint32, 4 zero bytes, then one int8 value per
+// position, at the index given by egdb_index.
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+const int PITS = 12;
+const int8_t UNKNOWN = -128;
+
+uint64_t binom[64][PITS + 1];
+
+void init_binom() {
+  for (int n = 0; n < 64; n++) {
+    binom[n][0] = 1;
+    for (int k = 1; k <= PITS; k++) {
+      binom[n][k] = n ? binom[n - 1][k - 1] + binom[n - 1][k] : 0;
+    }
+  }
+}
+
+// the running totals of the pits, each plus its pit number, are 12
+// increasing numbers, and this is their rank among all such sets. the
+// positions with fewer gems come first, so the index does not depend on N
+// and a database for N holds binom[N + 12][12] positions.
+uint64_t egdb_index(const uint8_t* q) {
+  uint64_t index = 0;
+  int total = 0;
+  for (int j = 0; j < PITS; j++) {
+    total += q[j];
+    index += binom[total + j][j + 1];
+  }
+  return index;
+}
+
+vector<int8_t> values;
+
+int solve(const uint8_t* q) {
+  int8_t& v = values[egdb_index(q)];
+  if (v != UNKNOWN) return v;
+
+  int mine = 0, theirs = 0;
+  for (int i = 0; i < 6; i++) {
+    mine += q[i];
+    theirs += q[i + 6];
+  }
+  // one side is out of moves, and each side keeps what is left on its side
+  if (!mine || !theirs) return v = mine - theirs;
+
+  int best = -PITS * 64;
+  for (int idx = 0; idx < 6; idx++) {
+    if (!q[idx]) continue;
+
+    // sown round 13 places: own pits 0 to 5, own store 6, and the
+    // opponent's pits, which are q[6] to q[11], at 7 to 12
+    uint8_t next[PITS];
+    copy(q, q + PITS, next);
+    int gems = next[idx], gain = 0, at = idx;
+    next[idx] = 0;
+    while (gems--) {
+      at = (at + 1) % 13;
+      if (at == 6)
+        gain++;
+      else
+        next[at < 6 ? at : at - 1]++;
+    }
+
+    int score;
+    if (at == 6) {
+      // another turn
+      score = gain + solve(next);
+    } else {
+      if (at < 6 && next[at] == 1 && next[11 - at]) {
+        gain += 1 + next[11 - at];
+        next[at] = next[11 - at] = 0;
+      }
+      uint8_t flipped[PITS];
+      copy(next + 6, next + PITS, flipped);
+      copy(next, next + 6, flipped + 6);
+      score = gain - solve(flipped);
+    }
+    best = max(best, score);
+  }
+  return v = best;
+}
+
+// solves every position with exactly gems left in pits from pit j on
+void solve_level(uint8_t* q, int j, int gems) {
+  if (j == PITS - 1) {
+    q[j] = gems;
+    solve(q);
+    return;
+  }
+  for (int g = 0; g <= gems; g++) {
+    q[j] = g;
+    solve_level(q, j + 1, gems - g);
+  }
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 16;
+  const char* path = argc > 2 ? argv[2] : "endgame.db";
+  if (n < 0 || n > 48) {
+    cerr << "N has to be from 0 to 48\n";
+    return 1;
+  }
+  init_binom();
+
+  values.assign(binom[n + PITS][PITS], UNKNOWN);
+  cerr << "Positions: " << values.size() << "\n";
+  for (int gems = 0; gems <= n; gems++) {
+    uint8_t q[PITS];
+    solve_level(q, 0, gems);
+    cerr << "Solved " << gems << " gems, " << binom[gems + PITS][PITS]
+         << " positions so far\n";
+  }
+  for (int8_t v : values) assert(v != UNKNOWN);
+
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    cerr << "Cannot open " << path << "\n";
+    return 1;
+  }
+  uint32_t header[2] = {(uint32_t)n, 0};
+  bool ok = fwrite("MANCALA", 1, 8, f) == 8 &&
+            fwrite(header, sizeof(header), 1, f) == 1 &&
+            fwrite(values.data(), 1, values.size(), f) == values.size();
+  if (fclose(f) != 0 || !ok) {
+    cerr << "Cannot write " << path << "\n";
+    return 1;
+  }
+  cout << "Wrote " << path << ": " << values.size() << " positions, up to "
+       << n << " gems\n";
+  return 0;
+}
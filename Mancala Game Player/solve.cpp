@@ -1,49 +1,173 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <random>
 #include <set>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 using namespace std;
 
-int explored = 0, pruned = 0;
+int explored = 0, pruned = 0, tt_hits = 0;
 const double INF = 2e17;
-int MAX_DEPTH;
-clock_t timer;
-double time_limit = 0.9;  // for each branch
+int MAX_DEPTH;              // deepest iteration of the iterative deepening
+double time_limit = 1;      // wall-clock seconds for each move
+int threads = max(1u, thread::hardware_concurrency());  // searching a move
+atomic<bool> search_stopped;  // the deadline passed, or the search is done
+chrono::steady_clock::time_point deadline;
 enum GameMode { HUMAN_AI, AI_AI };
 GameMode cur_mode;
 
+// zobrist keys: one random number per (pit, gem count), xor-ed together for
+// a board, plus one for player 2 to move. there are 48 gems in all.
+// zobrist_p2_search goes into the table keys of player 2's searches, so that
+// two AIs playing each other keep to their own entries.
+const int MAX_GEMS = 48;
+uint64_t zobrist[14][MAX_GEMS + 1], zobrist_p2, zobrist_p2_search;
+
+void init_zobrist() {
+  mt19937_64 rng(318);  // fixed, so that runs are repeatable
+  for (int i = 0; i < 14; i++) {
+    for (int g = 0; g <= MAX_GEMS; g++) zobrist[i][g] = rng();
+  }
+  zobrist_p2 = rng();
+  zobrist_p2_search = rng();
+}
+
+// weights of the terms of the heuristics, indexed by heuristic. each is a
+// weighted sum of the difference in the stores, the difference in the gems
+// on either side, extra turns won and gems captured (player 1's minus
+// player 2's) and the difference in the biggest capture either player has
+// ready. --weights replaces them from a file.
+struct Weights {
+  double store, side_gems, moves_won, captured, best_cap;
+};
+
+Weights heuristic_weights[6] = {
+    {0, 0, 0, 0, 0},         {1, 0, 0, 0, 0},        {0.75, 0.25, 0, 0, 0},
+    {0.7, 0.2, 0.5, 0, 0},   {1, 0.55, 4, 2, 0},     {1.2, 1, 3, 1.5, 1.75},
+};
+
+// the moves of a position, at most one per pit, kept on the stack
+struct MoveList {
+  int8_t m[6];
+  int n = 0;
+  uint16_t tactical = 0;  // a bit per pit whose move earns a turn or captures
+
+  int8_t* begin() { return m; }
+  int8_t* end() { return m + n; }
+  int size() const { return n; }
+  int operator[](int i) const { return m[i]; }
+  void push_back(int move) { m[n++] = move; }
+};
+
 struct MancalaNode {
  public:
-  vector<int> p;  // 0 to 5 are player 1's pits, 6 is player 1's storage bin,
-                  // 7 to 12 are player 2's pits, 13 is player 2's storage bin
-  bool p1Turn;    // true if player 1's turn
+  array<uint8_t, 14> p;  // 0 to 5 are player 1's pits, 6 is player 1's
+                         // storage bin, 7 to 12 are player 2's pits, 13 is
+                         // player 2's storage bin
+  bool p1Turn;           // true if player 1's turn
   int captured_gems, moves_won;
+  uint64_t hash;  // zobrist hash of the pits, kept up to date by set_pit
+
+  // everything execute_move changes, to take a move back in negamax
+  struct Undo {
+    array<uint8_t, 14> p;
+    bool p1Turn;
+    int captured_gems, moves_won;
+    uint64_t hash;
+  };
 
   MancalaNode() {
-    p.assign(14, 4);  // 7th index is storage bin
+    p.fill(4);  // 7th index is storage bin
     p[6] = p[13] = 0;
     captured_gems = moves_won = 0;
     p1Turn = true;
+
+    hash = 0;
+    for (int i = 0; i < 14; i++) hash ^= zobrist[i][p[i]];
   }
 
-  vector<int> get_next_moves() {
-    vector<int> moves;
-    int start = p1Turn ? 0 : 7;
-    for (int i = start; i < start + 6; i++) {
-      if (p[i] > 0) moves.push_back(i);
-    }
+  void set_pit(int i, int gems) {
+    hash ^= zobrist[i][p[i]] ^ zobrist[i][gems];
+    p[i] = gems;
+  }
 
-    random_shuffle(moves.begin(), moves.end());
+  // the turn is flipped by the callers, so it is only folded in here
+  uint64_t key() const { return p1Turn ? hash : hash ^ zobrist_p2; }
+
+  Undo save() const { return Undo{p, p1Turn, captured_gems, moves_won, hash}; }
+
+  void restore(const Undo& u) {
+    p = u.p;
+    p1Turn = u.p1Turn;
+    captured_gems = u.captured_gems;
+    moves_won = u.moves_won;
+    hash = u.hash;
+  }
+
+  // pit the last gem sown from idx lands in. sowing skips the opponent's
+  // store, so it goes round 13 pits
+  int landing_pit(int idx) const {
+    int own = p1Turn ? 0 : 7;
+    int step = (idx - own + p[idx]) % 13;  // pits past own pit 0 of the row
+    return (own + step) % 14;
+  }
+
+  // moves that earn another turn first (nearest the store first), then
+  // captures (biggest first), then the rest from the store side back
+  MoveList get_next_moves() const {
+    MoveList moves;
+    int start = p1Turn ? 0 : 7, store = start + 6;
+    int rank[6];
+
+    for (int i = start + 5; i >= start; i--) {
+      if (!p[i]) continue;
+      int last = landing_pit(i), r = 0;
+      if (last == store) {
+        r = 100 - i;
+      } else if (p[i] < 13 && last >= start && last < store && !p[last] &&
+                 p[12 - last]) {
+        r = 50 + p[12 - last];
+      }
+      if (r) moves.tactical |= 1 << i;
+
+      // insertion by rank, stable so equal ranks keep the pit order
+      int j = moves.n;
+      moves.push_back(i);
+      while (j > 0 && rank[j - 1] < r) {
+        moves.m[j] = moves.m[j - 1];
+        rank[j] = rank[j - 1];
+        j--;
+      }
+      moves.m[j] = i;
+      rank[j] = r;
+    }
 
     return moves;
   }
 
-  bool is_game_over() {
+  bool is_game_over() const {
     bool p1Empty = true;
     bool p2Empty = true;
     for (int i = 0; i < 6; i++) {
@@ -53,7 +177,7 @@ struct MancalaNode {
     return p1Empty || p2Empty;
   }
 
-  pair<int, int> compute_final_score() {
+  pair<int, int> compute_final_score() const {
     int p1_score = accumulate(p.begin(), p.begin() + 6, 0);
     int p2_score = accumulate(p.begin() + 7, p.begin() + 13, 0);
     p1_score += p[6];
@@ -70,7 +194,7 @@ struct MancalaNode {
     // will return if a move is repeated
 
     int stones = p[idx];
-    p[idx] = 0;
+    set_pit(idx, 0);
     int i = idx + 1;
     while (stones > 0) {
       if (p1Turn && i == 13) {
@@ -81,7 +205,7 @@ struct MancalaNode {
         i++;
         continue;
       }
-      p[i]++;
+      set_pit(i, p[i] + 1);
       stones--;
       i++;
       if (i == 14) i = 0;
@@ -93,17 +217,19 @@ struct MancalaNode {
 
     if (p1Turn) {
       if (last <= 5 && p[last] == 1 && p[12 - last]) {
-        p[6] += p[12 - last] + p[last];
+        set_pit(6, p[6] + p[12 - last] + p[last]);
         captured_gems += p[12 - last] + p[last];
         // cerr << "P1 captured " << p[12 - last] + p[last] << " gems" << endl;
-        p[last] = p[12 - last] = 0;
+        set_pit(last, 0);
+        set_pit(12 - last, 0);
       }
     } else {
       if (last >= 7 && last <= 12 && p[last] == 1 && p[12 - last]) {
-        p[13] += p[12 - last] + p[last];
+        set_pit(13, p[13] + p[12 - last] + p[last]);
         captured_gems -= p[12 - last] + p[last];
         // cerr << "P2 captured " << p[12 - last] + p[last] << " gems" << endl;
-        p[last] = p[12 - last] = 0;
+        set_pit(last, 0);
+        set_pit(12 - last, 0);
       }
     }
 
@@ -116,7 +242,7 @@ struct MancalaNode {
     }
   }
 
-  double evaluate(int heuristic_idx, int depth) {
+  double evaluate(int heuristic_idx, int depth) const {
     if (heuristic_idx == -1) {
       // game literally over
       int p1_score, p2_score;
@@ -138,41 +264,32 @@ struct MancalaNode {
     int opp_side_gems = accumulate(p.begin() + 7, p.begin() + 13, 0);
     int my_store = p[6], opp_store = p[13];
 
+    const Weights& w = heuristic_weights[heuristic_idx];
     double score = 0;
+    score += w.store * (my_store - opp_store);
+    score += w.side_gems * (my_side_gems - opp_side_gems);
+    score += w.moves_won * moves_won;
+    score += w.captured * captured_gems;
 
-    if (heuristic_idx == 1) {
-      score = my_store - opp_store;
-    } else if (heuristic_idx == 2) {
-      score =
-          0.75 * (my_store - opp_store) + 0.25 * (my_side_gems - opp_side_gems);
-    } else if (heuristic_idx == 3) {
-      score = 0.7 * (my_store - opp_store) +
-              0.2 * (my_side_gems - opp_side_gems) + 0.5 * moves_won;
-    } else if (heuristic_idx == 4) {
-      score = 1 * (my_store - opp_store) +
-              0.55 * (my_side_gems - opp_side_gems) + 4 * moves_won +
-              2 * captured_gems;
-    } else if (heuristic_idx == 5) {
-      const double store_weight = 1.2, side_gems_weight = 1,
-                   moves_won_weight = 3, capture_weight = 1.5,
-                   best_cap_weight = 1.75;
-
-      score += store_weight * (my_store - opp_store);
-      score += side_gems_weight * (my_side_gems - opp_side_gems);
-      score += moves_won_weight * moves_won;
-      score += capture_weight * captured_gems;
-
+    if (w.best_cap) {
       int best_cap_p1 = 0, best_cap_p2 = 0;
       for (int i = 0; i < 6; i++) {
-        if (p[i] <= 1) best_cap_p1 = max(best_cap_p1, p[i + 7]);
-        if (p[i + 7] <= 1) best_cap_p2 = max(best_cap_p2, p[i]);
+        if (p[i] <= 1) best_cap_p1 = max(best_cap_p1, (int)p[i + 7]);
+        if (p[i + 7] <= 1) best_cap_p2 = max(best_cap_p2, (int)p[i]);
       }
-      score += best_cap_weight * (best_cap_p1 - best_cap_p2);
+      score += w.best_cap * (best_cap_p1 - best_cap_p2);
     }
 
     return score;
   }
 
+  // the part of evaluate() that depends on how the board was reached rather
+  // than on the board itself
+  double path_score(int heuristic_idx) const {
+    const Weights& w = heuristic_weights[heuristic_idx];
+    return w.moves_won * moves_won + w.captured * captured_gems;
+  }
+
   friend ostream& operator<<(ostream& os, const MancalaNode& node) {
     os << "\n\t\t\tP2\n\nIndex:\t";
     // show the indices over the pits
@@ -186,12 +303,13 @@ struct MancalaNode {
     }
     os << "\nGems:\t";
     for (int i = 12; i >= 7; i--) {
-      os << node.p[i] << "\t";
+      os << (int)node.p[i] << "\t";
     }
     os << "\n\n"
-       << node.p[13] << "\t\t\t\t\t\t\t" << node.p[6] << "\n\nGems:\t";
+       << (int)node.p[13] << "\t\t\t\t\t\t\t" << (int)node.p[6]
+       << "\n\nGems:\t";
     for (int i = 0; i < 6; i++) {
-      os << node.p[i] << "\t";
+      os << (int)node.p[i] << "\t";
     }
     os << "\n\t";
     for (int i = 0; i < 6; i++) {
@@ -206,97 +324,419 @@ struct MancalaNode {
   }
 };
 
-int best_move = -1;
-clock_t start_timer;
+// transposition table: a fixed number of slots picked by the low bits of the
+// zobrist key. scores are from the side to move's side, as negamax returns
+// them, and stored without the node's path_score, so the same board reached
+// through different captures or extra turns shares its entry. that is exact
+// for heuristic leaves; finished games score without path terms, so a
+// shared entry can be off by a few points there, next to a 1e9 scale.
+//
+// the search threads share the table without locks. a slot is three words
+// written one by one, and the first is the key xor-ed with the other two, so
+// a slot torn by two threads writing at once reads as a miss.
+enum Bound : uint8_t { EXACT, LOWER, UPPER };
+
+struct TTEntry {
+  double score;
+  int depth;  // plies searched below the node
+  Bound bound;
+  int move;  // best move found, -1 if none
+};
 
-double minimax(MancalaNode node, int depth, double alpha, double beta,
-               bool repeat_move, int heuristics_index) {
-  explored++;
-  vector<int> moves = node.get_next_moves();
-  if (depth == 0) {
-    assert(moves.size() > 0);
-    best_move = moves[0];
+struct TranspositionTable {
+  struct Slot {
+    atomic<uint64_t> check, score, data;  // data 0 for an empty slot
+  };
+
+  vector<Slot> slots;
+  uint8_t age = 0;  // of the current search, only changed between searches
+
+  // depth + 1, bound, move + 1 and age, one byte each
+  static uint64_t pack(int depth, Bound bound, int move, uint8_t age) {
+    return (uint64_t)(depth + 1) | (uint64_t)bound << 8 |
+           (uint64_t)(move + 1) << 16 | (uint64_t)age << 24;
   }
 
-  if (node.is_game_over())
-    return node.evaluate(-1, depth);
-  else if (node.p[6] > 24 || node.p[13] > 24)
-    return node.evaluate(-2, depth);
-  else if (!repeat_move && depth >= MAX_DEPTH &&
-           (cur_mode == AI_AI ||
-            clock() - start_timer >= time_limit * CLOCKS_PER_SEC)) {
-    return node.evaluate(heuristics_index, depth);
+  static uint64_t bits(double score) {
+    uint64_t b;
+    memcpy(&b, &score, sizeof(b));
+    return b;
   }
 
-  double best, score;
+  TranspositionTable(int bits) : slots(1 << bits) {}
 
-  if (node.p1Turn) {
-    best = -INF;
-    int i = 0;
+  bool probe(uint64_t key, TTEntry& e) const {
+    const Slot& s = slots[key & (slots.size() - 1)];
+    uint64_t score = s.score.load(memory_order_relaxed);
+    uint64_t data = s.data.load(memory_order_relaxed);
+    uint64_t check = s.check.load(memory_order_relaxed);
+    if (!data || (check ^ score ^ data) != key) return false;
 
-    for (int next_move : moves) {
-      i++;
-      MancalaNode next_node = node;
+    memcpy(&e.score, &score, sizeof(score));
+    e.depth = (int)(data & 0xff) - 1;
+    e.bound = (Bound)(data >> 8 & 0xff);
+    e.move = (int)(data >> 16 & 0xff) - 1;
+    return true;
+  }
 
-      if (depth == 0) start_timer = clock();
+  // another board only replaces an entry of this search that was searched
+  // at least as deep; entries from earlier searches always give way
+  void store(uint64_t key, double score, int depth, Bound bound, int move) {
+    Slot& s = slots[key & (slots.size() - 1)];
+    uint64_t old_score = s.score.load(memory_order_relaxed);
+    uint64_t old_data = s.data.load(memory_order_relaxed);
+    uint64_t old_key =
+        s.check.load(memory_order_relaxed) ^ old_score ^ old_data;
+    if (old_data && old_key != key && (old_data >> 24 & 0xff) == age &&
+        (int)(old_data & 0xff) - 1 > depth) {
+      return;
+    }
 
-      bool another_turn = next_node.execute_move(next_move);
-      if (!another_turn) next_node.p1Turn = !next_node.p1Turn;
-      score = minimax(next_node, depth + 1, alpha, beta, another_turn,
-                      heuristics_index);
+    uint64_t b = bits(score), data = pack(min(depth, 254), bound, move, age);
+    s.check.store(key ^ b ^ data, memory_order_relaxed);
+    s.score.store(b, memory_order_relaxed);
+    s.data.store(data, memory_order_relaxed);
+  }
 
-      // cerr << "Depth " << depth << " Move " << i << " Score " << score <<
-      // "\n";
+  // starts loading the slot of a key that is about to be probed
+  void prefetch(uint64_t key) const {
+    __builtin_prefetch(&slots[key & (slots.size() - 1)]);
+  }
 
-      if (score > best) {
-        best = score;
-        if (depth == 0) best_move = next_move;
-      }
-      alpha = max(alpha, best);
+  void new_search() { age++; }
 
-      if (alpha >= beta) {
-        // cerr << "Pruned " << moves.size() - i << " moves\n";
-        pruned += moves.size() - i;
-        break;
+  // forgets every entry, so that a game does not depend on the ones before
+  void clear() {
+    for (Slot& s : slots) s.data.store(0, memory_order_relaxed);
+  }
+};
+
+TranspositionTable tt(20);  // 2^20 entries, 24 MB
+
+// maps the file at path read-only if it has a 16 byte header starting with
+// the 8 byte magic, and returns it with its size in *size, or nullptr. the
+// caller unmaps it with munmap, also when the rest of the file is not valid.
+const char* map_file(const string& path, const char* magic, size_t* size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < 16) {
+    close(fd);
+    return nullptr;
+  }
+  void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) return nullptr;
+  if (memcmp(p, magic, 8)) {
+    munmap(p, st.st_size);
+    return nullptr;
+  }
+  *size = st.st_size;
+  return (const char*)p;
+}
+
+// endgame database made by egdb.cpp, mapped read-only from its file: the
+// exact result of every position with at most `gems` gems left in the pits,
+// from the side to move. see egdb.cpp for the layout.
+struct EndgameDB {
+  const int8_t* values = nullptr;
+  void* mapped = nullptr;
+  size_t mapped_size = 0;
+  int gems = -1;  // none loaded
+  uint64_t binom[64][13];
+
+  ~EndgameDB() {
+    if (mapped) munmap(mapped, mapped_size);
+  }
+
+  bool load(const string& path) {
+    size_t size;
+    const char* data = map_file(path, "MANCALA", &size);
+    if (!data) return false;
+
+    for (int n = 0; n < 64; n++) {
+      binom[n][0] = 1;
+      for (int k = 1; k <= 12; k++) {
+        binom[n][k] = n ? binom[n - 1][k - 1] + binom[n - 1][k] : 0;
       }
     }
 
-    return best;
+    uint32_t n;
+    memcpy(&n, data + 8, 4);
+    if (n > MAX_GEMS || size != 16 + binom[n + 12][12]) {
+      munmap((void*)data, size);
+      return false;
+    }
+    if (mapped) munmap(mapped, mapped_size);
+    mapped = (void*)data;
+    mapped_size = size;
+    values = (const int8_t*)(data + 16);
+    gems = n;
+    return true;
+  }
+
+  // final score of player 1 minus player 2's, if the position is covered
+  bool probe(const MancalaNode& node, int& diff) const {
+    if (MAX_GEMS - node.p[6] - node.p[13] > gems) return false;
+
+    // the side to move's pits first
+    int own = node.p1Turn ? 0 : 7, opp = 7 - own;
+    uint64_t index = 0;
+    int total = 0;
+    for (int j = 0; j < 12; j++) {
+      total += node.p[j < 6 ? own + j : opp + j - 6];
+      index += binom[total + j][j + 1];
+    }
+    int v = values[index];
+    diff = node.p[6] - node.p[13] + (node.p1Turn ? v : -v);
+    return true;
   }
+};
 
-  else {
-    best = INF;
-    int i = 0;
+EndgameDB egdb;
 
-    for (int next_move : moves) {
-      i++;
-      MancalaNode next_node = node;
+// opening book made by solve --make-book, mapped read-only from its file:
+// the move a deep search chose for each position near the start, sorted by
+// the position's zobrist key. it is only used by the heuristic it was made
+// with.
+struct BookEntry {
+  uint64_t key;
+  int32_t move, depth;
+};
 
-      if (depth == 0) start_timer = clock();
+struct OpeningBook {
+  const BookEntry* entries = nullptr;
+  size_t count = 0;
+  void* mapped = nullptr;
+  size_t mapped_size = 0;
+  int heuristic = 0;  // none loaded
 
-      bool another_turn = next_node.execute_move(next_move);
-      if (!another_turn) next_node.p1Turn = !next_node.p1Turn;
-      score = minimax(next_node, depth + 1, alpha, beta, another_turn,
-                      heuristics_index);
+  ~OpeningBook() {
+    if (mapped) munmap(mapped, mapped_size);
+  }
 
-      // cerr << "Depth " << depth << " Move " << i << " Score " << score <<
-      // "\n";
+  bool load(const string& path) {
+    size_t size;
+    const char* data = map_file(path, "MNCLBOOK", &size);
+    if (!data) return false;
 
-      if (score < best) {
-        best = score;
-        if (depth == 0) best_move = next_move;
-      }
-      beta = min(beta, best);
+    uint32_t h;
+    memcpy(&h, data + 8, 4);
+    if (h < 1 || h > 5 || (size - 16) % sizeof(BookEntry)) {
+      munmap((void*)data, size);
+      return false;
+    }
+    if (mapped) munmap(mapped, mapped_size);
+    mapped = (void*)data;
+    mapped_size = size;
+    entries = (const BookEntry*)(data + 16);
+    count = (size - 16) / sizeof(BookEntry);
+    heuristic = h;
+    return true;
+  }
 
-      if (alpha >= beta) {
-        // cerr << "Pruned " << moves.size() - i << " moves\n";
-        pruned += moves.size() - i;
-        break;
-      }
+  // the book move of the position, or -1
+  int probe(const MancalaNode& node, int heuristics_index) const {
+    if (heuristics_index != heuristic) return -1;
+    uint64_t key = node.key();
+    const BookEntry* e = lower_bound(
+        entries, entries + count, key,
+        [](const BookEntry& a, uint64_t k) { return a.key < k; });
+    if (e == entries + count || e->key != key) return -1;
+    // a key shared by another position could name an empty pit
+    int own = node.p1Turn ? 0 : 7;
+    if (e->move < own || e->move > own + 5 || !node.p[e->move]) return -1;
+    return e->move;
+  }
+};
+
+OpeningBook book;
+
+// what one search thread keeps to itself. the threads only share the
+// transposition table, the deadline and search_stopped.
+const int MAX_PLY = 64;  // deepest ply with killer moves
+
+struct SearchThread {
+  int id = 0;  // 0 is the main thread
+  uint64_t salt = 0;  // xor-ed into the table keys, by the side searching
+  int explored = 0, pruned = 0, tt_hits = 0;
+  int search_depth = 0;  // depth of the current iteration
+  int best_move = -1;    // best root move of the current iteration
+  int pv_move = -1;      // best root move of the last one, searched first
+  double score = 0;      // of the root in the last iteration
+  int move = -1, reached = 0;  // of the deepest iteration finished
+
+  // moves that caused a cutoff: the last two quiet ones (no extra turn or
+  // capture) at every ply, and a score for every side and pit that grows
+  // with the depth of the cutoffs
+  int killers[MAX_PLY][2];
+  long long history[2][13] = {};
+
+  SearchThread() {
+    for (auto& k : killers) k[0] = k[1] = -1;
+  }
+};
+
+// the table's move first, then the moves that earn another turn or
+// capture, then the quiet ones, each by history and otherwise in the order
+// get_next_moves gave them. the ply's killers only go first among quiet
+// moves of the same history: put ahead of all of them they cost nodes, as
+// a ply here mixes both sides' moves through extra turns.
+void order_moves(const SearchThread& t, const MancalaNode& node,
+                 MoveList& moves, int depth, int tt_move) {
+  const long long TIER = 1LL << 50;  // past any history
+  int side = node.p1Turn ? 0 : 1;
+  long long rank[6];
+  for (int i = 0; i < moves.size(); i++) {
+    int m = moves[i];
+    if (m == tt_move)
+      rank[i] = 2 * TIER;
+    else if (moves.tactical >> m & 1)
+      rank[i] = TIER + t.history[side][m];
+    else if (depth < MAX_PLY && m == t.killers[depth][0])
+      rank[i] = t.history[side][m] + 2;
+    else if (depth < MAX_PLY && m == t.killers[depth][1])
+      rank[i] = t.history[side][m] + 1;
+    else
+      rank[i] = t.history[side][m];
+  }
+
+  // insertion sort, stable so that equal ranks keep their order
+  for (int i = 1; i < moves.size(); i++) {
+    int8_t m = moves.m[i];
+    long long r = rank[i];
+    int j = i;
+    for (; j > 0 && rank[j - 1] < r; j--) {
+      moves.m[j] = moves.m[j - 1];
+      rank[j] = rank[j - 1];
     }
+    moves.m[j] = m;
+    rank[j] = r;
+  }
+}
+
+// negamax: scores are from the side to move's point of view, so one loop
+// serves both players. a move that earns another turn keeps the side to
+// move, so its score is not negated. node is played on in place and left as
+// it was on return.
+double negamax(SearchThread& t, MancalaNode& node, int depth, double alpha,
+               double beta, bool repeat_move, int heuristics_index) {
+  // the main thread's first iteration always finishes, so there is a move
+  // to fall back on
+  bool stoppable = t.search_depth > 1 || t.id > 0;
+  if (stoppable && (t.explored & 1023) == 0 &&
+      chrono::steady_clock::now() >= deadline) {
+    search_stopped = true;
+  }
+  if (stoppable && search_stopped) return 0;  // thrown away by the caller
 
-    return best;
+  t.explored++;
+  MoveList moves = node.get_next_moves();
+  if (depth == 0) {
+    assert(moves.size() > 0);
+    // helpers start from a different root move, so that the threads do not
+    // all walk the same tree in step
+    rotate(moves.begin(), moves.begin() + t.id % moves.size(), moves.end());
+    auto it = find(moves.begin(), moves.end(), t.pv_move);
+    if (it != moves.end()) rotate(moves.begin(), it, it + 1);
+    t.best_move = moves[0];
   }
+
+  // evaluate() scores from player 1's side
+  double color = node.p1Turn ? 1 : -1;
+  int diff;
+  if (node.is_game_over())
+    return color * node.evaluate(-1, depth);
+  else if (depth > 0 && egdb.probe(node, diff))
+    return color * 1000000000LL * diff;  // scored as a finished game
+  else if (node.p[6] > 24 || node.p[13] > 24)
+    return color * node.evaluate(-2, depth);
+  else if (!repeat_move && depth >= t.search_depth) {
+    return color * node.evaluate(heuristics_index, depth);
+  }
+
+  // plies left to the depth limit; past it the search only goes on through
+  // extra turns, which counts as 0
+  int draft = max(0, t.search_depth - depth);
+  uint64_t key = node.key() ^ t.salt;
+  double offset = color * node.path_score(heuristics_index);
+  double alpha_orig = alpha, beta_orig = beta;
+  // a probe is mostly a cache miss, which costs more than searching the
+  // last ply or an extra turn past the limit, so those skip the table
+  bool use_tt = draft >= 2;
+
+  TTEntry entry;
+  int tt_move = -1;
+  if (use_tt && tt.probe(key, entry)) {
+    // the root has to pick best_move itself
+    if (depth > 0 && entry.depth >= draft) {
+      t.tt_hits++;
+      double s = entry.score + offset;
+      if (entry.bound == EXACT) return s;
+      if (entry.bound == LOWER) alpha = max(alpha, s);
+      if (entry.bound == UPPER) beta = min(beta, s);
+      if (alpha >= beta) return s;
+    }
+    tt_move = entry.move;
+  }
+  // the root keeps the last iteration's choice first
+  if (depth > 0) order_moves(t, node, moves, depth, tt_move);
+
+  double best = -INF;
+  int best_here = -1;
+  for (int i = 0; i < moves.size(); i++) {
+    int next_move = moves[i];
+    MancalaNode::Undo undo = node.save();
+
+    bool another_turn = node.execute_move(next_move);
+    if (!another_turn) node.p1Turn = !node.p1Turn;
+    if (draft >= 3) tt.prefetch(node.key() ^ t.salt);
+    auto search = [&](double a, double b) {
+      return another_turn ? negamax(t, node, depth + 1, a, b, true,
+                                    heuristics_index)
+                          : -negamax(t, node, depth + 1, -b, -a, false,
+                                     heuristics_index);
+    };
+
+    // principal variation search: the first move gets the whole window,
+    // the rest are only shown to be no better than alpha, with a window of
+    // no width, and searched again if they are
+    double score;
+    if (i == 0) {
+      score = search(alpha, beta);
+    } else {
+      score = search(alpha, nextafter(alpha, INF));
+      if (score > alpha && score < beta) score = search(alpha, beta);
+    }
+    node.restore(undo);
+
+    if (score > best) {
+      best = score;
+      best_here = next_move;
+      if (depth == 0) t.best_move = next_move;
+    }
+    alpha = max(alpha, best);
+
+    if (alpha >= beta) {
+      t.pruned += moves.size() - i - 1;
+      t.history[node.p1Turn ? 0 : 1][next_move] += (draft + 1) * (draft + 1);
+      bool quiet = !(moves.tactical >> next_move & 1);
+      if (quiet && depth < MAX_PLY && t.killers[depth][0] != next_move) {
+        t.killers[depth][1] = t.killers[depth][0];
+        t.killers[depth][0] = next_move;
+      }
+      break;
+    }
+  }
+
+  // a cut off search returned made-up scores
+  if (stoppable && search_stopped) return 0;
+
+  Bound bound = best <= alpha_orig  ? UPPER
+                : best >= beta_orig ? LOWER
+                                    : EXACT;
+  if (use_tt) tt.store(key, best - offset, draft, bound, best_here);
+  return best;
 }
 
 bool call_human_turn(MancalaNode& node) {
@@ -315,15 +755,102 @@ bool call_human_turn(MancalaNode& node) {
   return node.execute_move(move);
 }
 
+// iterative deepening on one thread: depth 1, 2, ... up to MAX_DEPTH until
+// the search is stopped. each iteration starts from the previous one's best
+// move and score, and the transposition table orders the rest. helpers with an odd id
+// start one ply deeper, so that the threads spread over two depths.
+void iterative_deepening(SearchThread& t, MancalaNode node,
+                         int heuristics_index,
+                         chrono::steady_clock::time_point start) {
+  for (t.search_depth = 1 + t.id % 2; t.search_depth <= MAX_DEPTH;
+       t.search_depth++) {
+    // aspiration: once there is a score to go by, the search starts with
+    // a narrow window around it and widens the side the score falls out of
+    double alpha = -INF, beta = INF, delta = 2, score;
+    if (t.reached > 0) alpha = t.score - delta, beta = t.score + delta;
+    while (true) {
+      t.best_move = -1;
+      score = negamax(t, node, 0, alpha, beta, false, heuristics_index);
+      if (search_stopped && (t.id > 0 || t.search_depth > 1)) break;
+      // finished games score a billion a gem, far past any narrow window
+      if (score <= alpha)
+        alpha = delta > 1000 ? -INF : score - delta;
+      else if (score >= beta)
+        beta = delta > 1000 ? INF : score + delta;
+      else
+        break;
+      delta *= 4;
+    }
+    if (search_stopped && (t.id > 0 || t.search_depth > 1)) break;
+    t.move = t.pv_move = t.best_move;
+    t.score = score;
+    t.reached = t.search_depth;
+
+    // the next iteration takes several times as long as this one did, so
+    // it would most likely be cut off
+    if (t.id == 0 &&
+        chrono::steady_clock::now() - start > (deadline - start) / 2) {
+      break;
+    }
+  }
+}
+
+// lazy SMP: every thread runs its own iterative deepening on the position
+// and they only share the transposition table, so each thread's results
+// speed up the others. the main thread decides when the move is over and
+// the move of the deepest iteration any thread finished is played. the
+// nodes searched are added to explored, pruned and tt_hits.
+int search_move(const MancalaNode& node, int heuristics_index, int& depth) {
+  auto start = chrono::steady_clock::now();
+  deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+                         chrono::duration<double>(time_limit));
+  tt.new_search();
+  search_stopped = false;
+
+  vector<SearchThread> states(threads);
+  for (int i = 0; i < threads; i++) {
+    states[i].id = i;
+    states[i].salt = node.p1Turn ? 0 : zobrist_p2_search;
+  }
+  vector<thread> helpers;
+  for (int i = 1; i < threads; i++) {
+    helpers.emplace_back(iterative_deepening, ref(states[i]), node,
+                         heuristics_index, start);
+  }
+  iterative_deepening(states[0], node, heuristics_index, start);
+  search_stopped = true;
+  for (thread& h : helpers) h.join();
+
+  const SearchThread* best = &states[0];
+  for (const SearchThread& t : states) {
+    explored += t.explored;
+    pruned += t.pruned;
+    tt_hits += t.tt_hits;
+    if (t.reached > best->reached) best = &t;
+  }
+  assert(best->move != -1);
+  depth = best->reached;
+  return best->move;
+}
+
 bool call_ai_turn(MancalaNode& node, int heuristics_index) {
-  best_move = -1;
-  timer = clock();
-  double score = minimax(node, 0, -INF, INF, false, heuristics_index);
-  cerr << "Time taken: " << (double)(clock() - timer) / CLOCKS_PER_SEC << "s\n";
-  assert(best_move != -1);
-  cerr << "Explored: " << explored << " Pruned: " << pruned << endl;
-  cout << "Move for AI: " << best_move + 1 << endl;
-  return node.execute_move(best_move);
+  int move = book.probe(node, heuristics_index);
+  if (move != -1) {
+    cerr << "Book move\n";
+    cout << "Move for AI: " << move + 1 << endl;
+    return node.execute_move(move);
+  }
+
+  auto start = chrono::steady_clock::now();
+  int depth;
+  move = search_move(node, heuristics_index, depth);
+  double secs =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cerr << "Time taken: " << secs << "s Depth: " << depth << "\n";
+  cerr << "Explored: " << explored << " Pruned: " << pruned
+       << " TT hits: " << tt_hits << endl;
+  cout << "Move for AI: " << move + 1 << endl;
+  return node.execute_move(move);
 }
 
 void show_results(MancalaNode& node, bool human_p1, int h1, int h2) {
@@ -358,7 +885,7 @@ void run_game(bool& my_turn, int h1, int h2) {
   bool human_p1 = my_turn;
 
   while (!node.is_game_over()) {
-    explored = pruned = 0;
+    explored = pruned = tt_hits = 0;
     bool again = false;
 
     if (cur_mode == HUMAN_AI) {
@@ -401,6 +928,7 @@ void ai_ai() {
 
   bool any;
   MAX_DEPTH = 10;
+  time_limit = 1;
   run_game(any, h1, h2);
 }
 
@@ -414,11 +942,546 @@ void human_ai() {
   }
 
   bool my_turn = (p == 1);
-  MAX_DEPTH = 12;
+  MAX_DEPTH = 20;
+  time_limit = 2;
   run_game(my_turn, 5, 5);
 }
 
-int main() {
+// weights file: a line per heuristic, its number and then its five
+// weights, in the order of Weights. lines starting with # are comments.
+bool load_weights(const string& path) {
+  ifstream in(path);
+  if (!in) return false;
+  for (string line; getline(in, line);) {
+    if (line.empty() || line[0] == '#') continue;
+    stringstream ss(line);
+    int h;
+    Weights w;
+    if (!(ss >> h >> w.store >> w.side_gems >> w.moves_won >> w.captured >>
+          w.best_cap) ||
+        h < 1 || h > 5) {
+      return false;
+    }
+    heuristic_weights[h] = w;
+  }
+  return true;
+}
+
+// written to a new file that then replaces path, so that a crash never
+// leaves half a file
+bool save_weights(const string& path, int h, const Weights& w,
+                  const string& comment) {
+  string tmp = path + ".tmp";
+  {
+    ofstream out(tmp);
+    out << "# " << comment << "\n"
+        << setprecision(17) << h << " " << w.store << " " << w.side_gems
+        << " " << w.moves_won << " " << w.captured << " " << w.best_cap
+        << "\n";
+    if (!out.flush()) return false;
+  }
+  return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// tournament: every pair of players plays the same seeded random openings,
+// each opening once with either player moving first. a player is a
+// heuristic with its weights and a fixed search depth, so that the games
+// are repeatable. the games are shared out to child processes, one per
+// core, which send their results back over a pipe.
+struct Player {
+  int heuristic, depth;
+  Weights weights;
+};
+
+struct GameRecord {
+  int game = -1;
+  int diff = 0;  // final score of player 1 minus player 2's
+  long long nodes[2] = {0, 0};  // by player 1 and player 2
+  double seconds[2] = {0, 0};
+  int moves[2] = {0, 0};
+};
+
+struct TournamentGame {
+  int p1, p2;  // indices of the players
+  int opening;
+};
+
+// plays a game quietly, from the position after the random opening moves
+GameRecord play_game(const vector<Player>& players, const TournamentGame& g,
+                     int opening_plies, unsigned seed) {
+  MancalaNode node;
+  mt19937 rng(seed * 1000003u + g.opening);
+  for (int i = 0; i < opening_plies && !node.is_game_over(); i++) {
+    MoveList moves = node.get_next_moves();
+    if (!node.execute_move(moves[rng() % moves.size()])) {
+      node.p1Turn = !node.p1Turn;
+    }
+  }
+
+  tt.clear();
+  GameRecord record;
+  while (!node.is_game_over()) {
+    int side = node.p1Turn ? 0 : 1;
+    const Player& player = players[side ? g.p2 : g.p1];
+    MAX_DEPTH = player.depth;
+    heuristic_weights[player.heuristic] = player.weights;
+    explored = pruned = tt_hits = 0;
+
+    auto start = chrono::steady_clock::now();
+    int depth, move = search_move(node, player.heuristic, depth);
+    record.seconds[side] +=
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    record.nodes[side] += explored;
+    record.moves[side]++;
+
+    if (!node.execute_move(move)) node.p1Turn = !node.p1Turn;
+  }
+  pair<int, int> scores = node.compute_final_score();
+  record.diff = scores.first - scores.second;
+  return record;
+}
+
+// runs job(i) for every i below count in child processes, one per
+// --threads, and returns the results in the order they came in, or none if
+// any went missing. a result is plain data under PIPE_BUF, so that the
+// children's writes over the shared pipe do not mix.
+template <typename Result, typename Job>
+vector<Result> run_in_children(int count, Job job) {
+  int fds[2];
+  if (pipe(fds) == -1) {
+    cerr << "Cannot open a pipe\n";
+    return {};
+  }
+  cout.flush();
+  int workers = min(threads, count);
+  vector<pid_t> children;
+  for (int w = 0; w < workers; w++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      threads = 1;  // the jobs are the parallel part
+      time_limit = 1e6;
+      for (int i = w; i < count; i += workers) {
+        Result result = job(i);
+        if (write(fds[1], &result, sizeof(result)) != sizeof(result)) _exit(1);
+      }
+      _exit(0);
+    }
+    if (pid != -1) children.push_back(pid);
+  }
+  close(fds[1]);
+
+  vector<Result> results;
+  Result result;
+  while (read(fds[0], &result, sizeof(result)) == sizeof(result)) {
+    results.push_back(result);
+  }
+  close(fds[0]);
+  for (pid_t pid : children) waitpid(pid, nullptr, 0);
+  if ((int)results.size() != count) {
+    cerr << "Only " << results.size() << " of " << count << " jobs finished\n";
+    return {};
+  }
+  return results;
+}
+
+vector<GameRecord> play_games(const vector<Player>& players,
+                              const vector<TournamentGame>& games,
+                              int opening_plies, unsigned seed) {
+  return run_in_children<GameRecord>(games.size(), [&](int i) {
+    GameRecord record = play_game(players, games[i], opening_plies, seed);
+    record.game = i;
+    return record;
+  });
+}
+
+// ratings that best explain the results between every pair (bradley-terry,
+// fitted by minorization-maximization), as elo with a mean of 0. every pair
+// gets one made-up draw, so that a player that never scores stays finite.
+vector<double> elo_ratings(const vector<vector<double>>& points,
+                           const vector<vector<int>>& games) {
+  int n = points.size();
+  vector<double> gamma(n, 1);
+  for (int it = 0; it < 1000; it++) {
+    vector<double> next(n);
+    for (int i = 0; i < n; i++) {
+      double won = 0, sum = 0;
+      for (int j = 0; j < n; j++) {
+        if (j == i) continue;
+        won += points[i][j] + 0.5;
+        sum += (games[i][j] + 1) / (gamma[i] + gamma[j]);
+      }
+      next[i] = won / sum;
+    }
+    gamma = next;
+  }
+
+  vector<double> elo(n);
+  for (int i = 0; i < n; i++) elo[i] = 400 * log10(gamma[i]);
+  double mean = accumulate(elo.begin(), elo.end(), 0.0) / n;
+  for (double& e : elo) e -= mean;
+  return elo;
+}
+
+// plays the tournament and prints two CSV tables, separated by a blank
+// line: the results of every pair, then each player's totals, elo and
+// average nodes and milliseconds per move
+int run_tournament(const string& player_list, int openings, int opening_plies,
+                   unsigned seed) {
+  vector<Player> players;
+  stringstream list(player_list);
+  for (string spec; getline(list, spec, ',');) {
+    Player player{0, 0, {}};
+    char colon = 0;
+    stringstream(spec) >> player.heuristic >> colon >> player.depth;
+    if (player.heuristic < 1 || player.heuristic > 5 || colon != ':' ||
+        player.depth < 1) {
+      cerr << "Invalid player: " << spec << "\n";
+      return 1;
+    }
+    player.weights = heuristic_weights[player.heuristic];
+    players.push_back(player);
+  }
+  int n = players.size();
+  if (n < 2) {
+    cerr << "A tournament needs two players\n";
+    return 1;
+  }
+
+  vector<TournamentGame> games;
+  for (int a = 0; a < n; a++) {
+    for (int b = a + 1; b < n; b++) {
+      for (int o = 0; o < openings; o++) {
+        games.push_back({a, b, o});
+        games.push_back({b, a, o});
+      }
+    }
+  }
+
+  vector<GameRecord> records =
+      play_games(players, games, opening_plies, seed);
+  if (records.empty()) return 1;
+
+  // results from the row player's side
+  vector<vector<int>> wins(n, vector<int>(n)), draws = wins, losses = wins;
+  vector<vector<double>> points(n, vector<double>(n));
+  vector<long long> nodes(n);
+  vector<double> seconds(n);
+  vector<int> moves(n);
+  for (const GameRecord& r : records) {
+    const TournamentGame& g = games[r.game];
+    int sides[2] = {g.p1, g.p2};
+    for (int s = 0; s < 2; s++) {
+      nodes[sides[s]] += r.nodes[s];
+      seconds[sides[s]] += r.seconds[s];
+      moves[sides[s]] += r.moves[s];
+    }
+
+    if (r.diff == 0) {
+      draws[g.p1][g.p2]++, draws[g.p2][g.p1]++;
+    } else {
+      int winner = r.diff > 0 ? g.p1 : g.p2, loser = g.p1 + g.p2 - winner;
+      wins[winner][loser]++, losses[loser][winner]++;
+    }
+  }
+  vector<vector<int>> played(n, vector<int>(n));
+  for (int a = 0; a < n; a++) {
+    for (int b = 0; b < n; b++) {
+      played[a][b] = wins[a][b] + draws[a][b] + losses[a][b];
+      points[a][b] = wins[a][b] + 0.5 * draws[a][b];
+    }
+  }
+  vector<double> elo = elo_ratings(points, played);
+
+  auto name = [&](int i) {
+    return "h" + to_string(players[i].heuristic) + "d" +
+           to_string(players[i].depth);
+  };
+  cout << "player,opponent,games,wins,draws,losses,score\n";
+  for (int a = 0; a < n; a++) {
+    for (int b = 0; b < n; b++) {
+      if (a == b) continue;
+      cout << name(a) << "," << name(b) << "," << played[a][b] << ","
+           << wins[a][b] << "," << draws[a][b] << "," << losses[a][b] << ","
+           << points[a][b] / played[a][b] << "\n";
+    }
+  }
+
+  cout << "\nplayer,heuristic,depth,games,wins,draws,losses,elo,"
+          "nodes_per_move,ms_per_move\n";
+  for (int a = 0; a < n; a++) {
+    int w = accumulate(wins[a].begin(), wins[a].end(), 0);
+    int d = accumulate(draws[a].begin(), draws[a].end(), 0);
+    int l = accumulate(losses[a].begin(), losses[a].end(), 0);
+    cout << name(a) << "," << players[a].heuristic << "," << players[a].depth
+         << "," << w + d + l << "," << w << "," << d << "," << l << ","
+         << round(elo[a]) << "," << (double)nodes[a] / max(1, moves[a]) << ","
+         << 1000 * seconds[a] / max(1, moves[a]) << "\n";
+  }
+  return 0;
+}
+
+// the score of players[0] against players[1] over the games, from -1 for
+// losing them all to 1 for winning them all
+double match_score(const vector<Player>& players,
+                   const vector<TournamentGame>& games, int opening_plies,
+                   unsigned seed, bool& ok) {
+  vector<GameRecord> records = play_games(players, games, opening_plies, seed);
+  ok = !records.empty();
+  double score = 0;
+  for (const GameRecord& r : records) {
+    int sign = games[r.game].p1 == 0 ? 1 : -1;
+    score += r.diff > 0 ? sign : r.diff < 0 ? -sign : 0;
+  }
+  return ok ? score / records.size() : 0;
+}
+
+// SPSA tuning of a heuristic's weights by self-play. every iteration nudges
+// the weights both ways along a random +-1 direction, plays the two against
+// each other on new openings with either moving first, and steps towards
+// the one that scored better; the nudges and steps shrink as it goes. the
+// store weight is left alone, since only the ratios between the weights
+// matter. the weights are saved to path after every iteration, with the
+// iteration in the comment, and a run with the same path picks up there.
+// at the end the tuned weights play the ones it started from.
+int run_tune(int h, int depth, int iterations, int openings,
+             int opening_plies, unsigned seed, const string& path) {
+  double Weights::*const terms[4] = {&Weights::side_gems, &Weights::moves_won,
+                                     &Weights::captured, &Weights::best_cap};
+  Weights start = heuristic_weights[h], w = start;
+  double nudge[4];  // at the first iteration
+  for (int i = 0; i < 4; i++) nudge[i] = 0.25 * max(1.0, fabs(start.*terms[i]));
+
+  int first = 0;
+  ifstream saved(path);
+  string line;
+  int saved_h, saved_it;
+  if (saved && getline(saved, line) &&
+      sscanf(line.c_str(), "# spsa heuristic %d iteration %d", &saved_h,
+             &saved_it) == 2 &&
+      saved_h == h) {
+    if (!load_weights(path)) {
+      cerr << "Cannot read " << path << "\n";
+      return 1;
+    }
+    w = heuristic_weights[h];
+    first = saved_it;
+    cerr << "Resuming from iteration " << first << "\n";
+  }
+
+  vector<TournamentGame> games;
+  for (int o = 0; o < openings; o++) {
+    games.push_back({0, 1, o});
+    games.push_back({1, 0, o});
+  }
+
+  double stability = iterations / 10.0;
+  for (int k = first; k < iterations; k++) {
+    double step = 0.5 * pow((1 + stability) / (k + 1 + stability), 0.602);
+    double shrink = pow(k + 1, -0.101);
+    mt19937 rng(seed * 1000003u + k);
+    int delta[4];
+    vector<Player> players(2, Player{h, depth, w});
+    for (int i = 0; i < 4; i++) {
+      delta[i] = rng() % 2 ? 1 : -1;
+      double c = nudge[i] * shrink * delta[i];
+      players[0].weights.*terms[i] += c;
+      players[1].weights.*terms[i] -= c;
+    }
+
+    bool ok;
+    double score = match_score(players, games, opening_plies,
+                               seed * 7919u + k, ok);
+    if (!ok) return 1;
+    for (int i = 0; i < 4; i++) {
+      w.*terms[i] += step * nudge[i] * shrink * score * delta[i];
+    }
+
+    string comment = "spsa heuristic " + to_string(h) + " iteration " +
+                     to_string(k + 1) + " of " + to_string(iterations) +
+                     ", depth " + to_string(depth);
+    if (!save_weights(path, h, w, comment)) {
+      cerr << "Cannot write " << path << "\n";
+      return 1;
+    }
+    if ((k + 1) % 10 == 0 || k + 1 == iterations) {
+      cerr << "Iteration " << k + 1 << ": score " << score << ", weights "
+           << w.store << " " << w.side_gems << " " << w.moves_won << " "
+           << w.captured << " " << w.best_cap << "\n";
+    }
+  }
+
+  // openings none of the iterations played
+  vector<TournamentGame> check;
+  for (int o = 0; o < 100; o++) {
+    check.push_back({0, 1, o});
+    check.push_back({1, 0, o});
+  }
+  vector<Player> players = {Player{h, depth, w}, Player{h, depth, start}};
+  bool ok;
+  double score = match_score(players, check, opening_plies,
+                             seed * 7919u + iterations, ok);
+  if (!ok) return 1;
+  cout << "Tuned weights in " << path << ", scoring " << score
+       << " against the ones it started from over " << check.size()
+       << " games\n";
+  return 0;
+}
+
+// writes an opening book: every position up to plies moves from the start
+// is searched to depth with heuristic h, the positions shared out to child
+// processes, and the chosen moves are written sorted by key after a 16 byte
+// header ("MNCLBOOK", h as uint32, 4 zero bytes)
+int make_book(const string& path, int h, int plies, int depth) {
+  vector<MancalaNode> positions;
+  set<uint64_t> seen;
+  vector<MancalaNode> frontier = {MancalaNode()};
+  for (int ply = 0; ply <= plies; ply++) {
+    vector<MancalaNode> next;
+    for (const MancalaNode& node : frontier) {
+      if (node.is_game_over() || !seen.insert(node.key()).second) continue;
+      positions.push_back(node);
+      if (ply == plies) continue;
+      for (int move : node.get_next_moves()) {
+        MancalaNode child = node;
+        if (!child.execute_move(move)) child.p1Turn = !child.p1Turn;
+        next.push_back(child);
+      }
+    }
+    frontier = next;
+  }
+  cerr << "Searching " << positions.size() << " positions to depth " << depth
+       << "\n";
+
+  MAX_DEPTH = depth;
+  vector<BookEntry> entries =
+      run_in_children<BookEntry>(positions.size(), [&](int i) {
+        tt.clear();
+        int reached, move = search_move(positions[i], h, reached);
+        return BookEntry{positions[i].key(), move, reached};
+      });
+  if (entries.empty()) return 1;
+  sort(entries.begin(), entries.end(),
+       [](const BookEntry& a, const BookEntry& b) { return a.key < b.key; });
+
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) {
+    cerr << "Cannot open " << path << "\n";
+    return 1;
+  }
+  uint32_t header[2] = {(uint32_t)h, 0};
+  bool ok = fwrite("MNCLBOOK", 1, 8, f) == 8 &&
+            fwrite(header, sizeof(header), 1, f) == 1 &&
+            fwrite(entries.data(), sizeof(BookEntry), entries.size(), f) ==
+                entries.size();
+  if (fclose(f) != 0 || !ok) {
+    cerr << "Cannot write " << path << "\n";
+    return 1;
+  }
+  cout << "Wrote " << path << ": " << entries.size() << " positions\n";
+  return 0;
+}
+
+// usage: solve [--threads n] [--egdb file] [--weights file] [--book file]
+//        solve --tournament [--players list] [--openings n]
+//              [--opening-plies n] [--seed s] [options above]
+//        solve --tune h [--depth d] [--iterations n] [--out file]
+//              [--openings n] [--opening-plies n] [--seed s] [options above]
+//        solve --make-book file [--book-heuristic h] [--book-plies n]
+//              [--depth d] [options above]
+//   --threads n        search threads for every AI move, or games played at
+//                      once in a tournament or tuning; all cores by default
+//   --egdb file        endgame database made by egdb, for exact endgames
+//   --weights file     weights of the heuristics, as written by --tune
+//   --book file        opening book made by --make-book, for the AI's moves
+//   --tournament       play every pair of players and print CSV results
+//   --players list     heuristic:depth list, 1:6,2:6,3:6,4:6,5:6 by default
+//   --openings n       random openings each pair plays, or each tuning
+//                      iteration plays, 10 by default
+//   --opening-plies n  random moves in an opening, 4 by default
+//   --seed s           seed of the openings, 1 by default
+//   --tune h           tune the weights of heuristic h by self-play (SPSA)
+//   --depth d          search depth of the tuning games, 4 by default, or
+//                      of the book positions, 14 by default
+//   --iterations n     SPSA iterations, 500 by default
+//   --out file         weights file written as it goes, and resumed from,
+//                      weights.txt by default
+//   --make-book file   search the positions near the start and write them
+//                      to an opening book
+//   --book-heuristic h heuristic the book is made with, 5 by default
+//   --book-plies n     moves from the start the book covers, 4 by default
+int main(int argc, char** argv) {
+  bool tournament = false;
+  string players = "1:6,2:6,3:6,4:6,5:6", out = "weights.txt", make;
+  int openings = 10, opening_plies = 4, tune = 0, depth = 0, iterations = 500;
+  int book_heuristic = 5, book_plies = 4;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      threads = max(1, atoi(argv[++i]));
+    } else if (arg == "--egdb" && i + 1 < argc) {
+      if (!egdb.load(argv[++i])) {
+        cerr << "Cannot load the endgame database " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (arg == "--weights" && i + 1 < argc) {
+      if (!load_weights(argv[++i])) {
+        cerr << "Cannot load the weights " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (arg == "--tune" && i + 1 < argc) {
+      tune = atoi(argv[++i]);
+      if (tune < 1 || tune > 5) {
+        cerr << "There is no heuristic " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (arg == "--depth" && i + 1 < argc) {
+      depth = max(1, atoi(argv[++i]));
+    } else if (arg == "--iterations" && i + 1 < argc) {
+      iterations = max(1, atoi(argv[++i]));
+    } else if (arg == "--out" && i + 1 < argc) {
+      out = argv[++i];
+    } else if (arg == "--book" && i + 1 < argc) {
+      if (!book.load(argv[++i])) {
+        cerr << "Cannot load the opening book " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (arg == "--make-book" && i + 1 < argc) {
+      make = argv[++i];
+    } else if (arg == "--book-heuristic" && i + 1 < argc) {
+      book_heuristic = atoi(argv[++i]);
+      if (book_heuristic < 1 || book_heuristic > 5) {
+        cerr << "There is no heuristic " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (arg == "--book-plies" && i + 1 < argc) {
+      book_plies = max(0, atoi(argv[++i]));
+    } else if (arg == "--tournament") {
+      tournament = true;
+    } else if (arg == "--players" && i + 1 < argc) {
+      players = argv[++i];
+    } else if (arg == "--openings" && i + 1 < argc) {
+      openings = max(1, atoi(argv[++i]));
+    } else if (arg == "--opening-plies" && i + 1 < argc) {
+      opening_plies = max(0, atoi(argv[++i]));
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else {
+      cerr << "Unknown option: " << arg << "\n";
+      return 1;
+    }
+  }
+  init_zobrist();
+  if (tournament) return run_tournament(players, openings, opening_plies, seed);
+  if (tune) {
+    return run_tune(tune, depth ? depth : 4, iterations, openings,
+                    opening_plies, seed, out);
+  }
+  if (!make.empty()) {
+    return make_book(make, book_heuristic, book_plies, depth ? depth : 14);
+  }
+
   cout << "Choose the game mode:\n";
   cout << "1. Human vs AI\n";
   cout << "2. AI vs AI\n\n";
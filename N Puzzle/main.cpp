@@ -1,127 +1,223 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <ostream>
 #include <queue>
-#include <set>
+#include <random>
+#include <sstream>
 #include <stack>
-#include <unordered_set>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 using namespace std;
 
-struct Node {
- public:
-  vector<vector<int>> grid;
-  Node *parent = nullptr;
-  int moves = 0, hamming_dist = -1, manhattan_dist = -1;
-  int zr = 0, zc = 0;
+// a board is packed into W 64-bit words, TILE_BITS bits per tile, with the
+// tile at row i, column j stored at position i * k + j. a single word holds
+// any board up to 4x4; 5x5 takes two words, 6x6 four and 7x7/8x8 eight.
+template <int W>
+struct PackedBoard {
+  static constexpr int TILE_BITS = W == 1 ? 4 : W == 2 ? 5 : 6;
+  static constexpr uint64_t TILE_MASK = (1ULL << TILE_BITS) - 1;
 
-  Node(int k = 0) { grid.assign(k, vector<int>(k, 0)); }
+  uint64_t w[W] = {};
 
-  Node(const vector<vector<int>> &grid, Node *par) {
-    this->grid = grid;
+  int get(int pos) const {
+    int off = pos * TILE_BITS, i = off >> 6, s = off & 63;
+    uint64_t v = w[i] >> s;
+    if (s + TILE_BITS > 64) v |= w[i + 1] << (64 - s);
+    return v & TILE_MASK;
+  }
 
-    for (int i = 0; i < grid.size(); i++) {
-      for (int j = 0; j < grid[i].size(); j++) {
-        if (!grid[i][j]) {
-          zr = i;
-          zc = j;
-          break;
-        }
-      }
+  void set(int pos, int tile) {
+    int off = pos * TILE_BITS, i = off >> 6, s = off & 63;
+    w[i] = (w[i] & ~(TILE_MASK << s)) | ((uint64_t)tile << s);
+    if (s + TILE_BITS > 64) {
+      int lo = 64 - s;  // bits that already went into w[i]
+      w[i + 1] = (w[i + 1] & ~(TILE_MASK >> lo)) | ((uint64_t)tile >> lo);
     }
-
-    hamming_dist = this->hamming_distance();
-    manhattan_dist = this->manhattan_distance();
-
-    this->parent = par;
-
-    moves = par ? par->moves + 1 : 0;
   }
 
-  int hamming_distance() {
-    int dist = 0;
+  size_t hash() const {
+    uint64_t h = 0;
+    for (int i = 0; i < W; i++) {
+      // splitmix64 finalizer
+      uint64_t x = h ^ w[i];
+      x += 0x9e3779b97f4a7c15ULL;
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      h = x ^ (x >> 31);
+    }
+    return h;
+  }
 
-    for (int i = 0; i < grid.size(); i++) {
-      for (int j = 0; j < grid[i].size(); j++) {
-        if (grid[i][j] && grid[i][j] != i * grid[i].size() + j + 1) dist++;
-      }
+  bool operator==(const PackedBoard &other) const {
+    for (int i = 0; i < W; i++) {
+      if (w[i] != other.w[i]) return false;
     }
+    return true;
+  }
+};
 
-    // cout << *this;
-    // cout << "hamming distance: " << dist << "\n";
+enum SearchMode {
+  A_STAR_MODE,
+  IDA_STAR_MODE,
+  HDA_STAR_MODE,
+  BIDIRECTIONAL_MODE,
+  EXTERNAL_MODE,
+  ANYTIME_MODE
+};
 
-    return dist;
-  }
+// number of words a k x k board needs, 0 if it is too large to pack
+constexpr int words_for(int k) {
+  if (k <= 4) return 1;
+  if (k == 5) return 2;
+  if (k == 6) return 4;
+  if (k <= 8) return 8;
+  return 0;
+}
 
-  int manhattan_distance() {
-    int dist = 0;
-    int actual_row, actual_col;
+// lookup tables for a k x k board, built at compile time so that moves and
+// heuristics need no division or bounds checks. positions are i * k + j as
+// in PackedBoard and directions are 0, 1, 2, 3 for left, right, up, down.
+template <int K>
+struct Geometry {
+  int row[K * K], col[K * K];
+  int goal_row[K * K], goal_col[K * K];  // of each tile
+  int neighbor[K * K][4];      // where the blank goes from pos, -1 if off
+  int distance[K * K][K * K];  // [tile][pos], manhattan distance to goal
 
-    for (int i = 0; i < grid.size(); i++) {
-      for (int j = 0; j < grid[i].size(); j++) {
-        actual_row = (grid[i][j] - 1) / grid[0].size();
-        actual_col = (grid[i][j] - 1) % grid[0].size();
-        if (grid[i][j]) dist += abs(i - actual_row) + abs(j - actual_col);
-      }
+  constexpr Geometry()
+      : row(), col(), goal_row(), goal_col(), neighbor(), distance() {
+    for (int pos = 0; pos < K * K; pos++) {
+      row[pos] = pos / K;
+      col[pos] = pos % K;
     }
+    for (int tile = 1; tile < K * K; tile++) {
+      goal_row[tile] = row[tile - 1];
+      goal_col[tile] = col[tile - 1];
+    }
+    goal_row[0] = goal_col[0] = K - 1;
 
-    // cout << *this;
-    // cout << "manhattan distance: " << dist << "\n";
-
-    return dist;
-  }
+    for (int pos = 0; pos < K * K; pos++) {
+      neighbor[pos][0] = col[pos] > 0 ? pos - 1 : -1;
+      neighbor[pos][1] = col[pos] < K - 1 ? pos + 1 : -1;
+      neighbor[pos][2] = row[pos] > 0 ? pos - K : -1;
+      neighbor[pos][3] = row[pos] < K - 1 ? pos + K : -1;
 
-  friend ostream &operator<<(ostream &os, const Node &node) {
-    for (int i = 0; i < node.grid.size(); i++) {
-      for (int j = 0; j < node.grid[i].size(); j++) {
-        os << node.grid[i][j];
-        os << " ";
+      for (int tile = 1; tile < K * K; tile++) {
+        int dr = row[pos] - goal_row[tile], dc = col[pos] - goal_col[tile];
+        distance[tile][pos] = (dr < 0 ? -dr : dr) + (dc < 0 ? -dc : dc);
       }
-      os << "\n";
     }
-    return os;
   }
+};
 
-  bool operator==(const Node &node) const {
-    assert(grid.size() == node.grid.size() &&
-           grid[0].size() == node.grid[0].size());
+template <int K>
+constexpr Geometry<K> geometry{};
 
-    for (int i = 0; i < grid.size(); i++) {
-      for (int j = 0; j < grid[i].size(); j++) {
-        if (grid[i][j] != node.grid[i][j]) return false;
-      }
-    }
+// open addressing (linear probing) map from packed boards to the fewest
+// moves (g) they have been reached with, and the node that reached them.
+// slots are marked used explicitly: every packed value, the all-zero one
+// included, is a real board for some k (the 1x1 board is all zero).
+template <int W>
+class StateMap {
+  vector<PackedBoard<W>> slots;
+  vector<uint8_t> used;
+  vector<int> best_g;
+  vector<uint32_t> best_node;
+  size_t count = 0;
 
-    return true;
+  size_t find_slot(const PackedBoard<W> &board) const {
+    size_t mask = slots.size() - 1;
+    size_t i = board.hash() & mask;
+    while (used[i] && !(slots[i] == board)) i = (i + 1) & mask;
+    return i;
   }
 
-  Node *make_move(int dir) {
-    // dir 0, 1, 2, 3 for left, right, up, down respectively
+  void grow() {
+    vector<PackedBoard<W>> old(slots.size() * 2);
+    vector<uint8_t> old_used(old.size());
+    vector<int> old_g(old.size());
+    vector<uint32_t> old_node(old.size());
+    old.swap(slots);
+    old_used.swap(used);
+    old_g.swap(best_g);
+    old_node.swap(best_node);
+    for (size_t i = 0; i < old.size(); i++) {
+      if (!old_used[i]) continue;
+      size_t j = find_slot(old[i]);
+      slots[j] = old[i];
+      used[j] = 1;
+      best_g[j] = old_g[i];
+      best_node[j] = old_node[i];
+    }
+  }
 
-    vector<vector<int>> new_grid = grid;
+ public:
+  StateMap(size_t capacity = 1 << 16) {
+    size_t n = 1;
+    while (n < capacity) n <<= 1;
+    slots.resize(n);
+    used.resize(n);
+    best_g.resize(n);
+    best_node.resize(n);
+  }
 
-    if (dir == 0) {
-      // left
-      assert(zc > 0);
-      swap(new_grid[zr][zc], new_grid[zr][zc - 1]);
-    } else if (dir == 1) {
-      // right
-      assert(zc < grid[0].size() - 1);
-      swap(new_grid[zr][zc], new_grid[zr][zc + 1]);
-    } else if (dir == 2) {
-      // up
-      assert(zr > 0);
-      swap(new_grid[zr][zc], new_grid[zr - 1][zc]);
-    } else if (dir == 3) {
-      // down
-      assert(zr < grid.size() - 1);
-      swap(new_grid[zr][zc], new_grid[zr + 1][zc]);
+  // records g (and the node) for the board if it is new or beats the stored
+  // g, and returns whether it did
+  bool improve(const PackedBoard<W> &board, int g, uint32_t node = 0) {
+    if (2 * (count + 1) > slots.size()) grow();
+    size_t i = find_slot(board);
+    if (!used[i]) {
+      slots[i] = board;
+      used[i] = 1;
+      count++;
+    } else if (best_g[i] <= g) {
+      return false;
     }
+    best_g[i] = g;
+    best_node[i] = node;
+    return true;
+  }
 
-    Node *new_node = new Node(new_grid, this);
+  // INT_MAX if the board was never seen
+  int get(const PackedBoard<W> &board) const {
+    size_t i = find_slot(board);
+    return used[i] ? best_g[i] : INT_MAX;
+  }
 
-    return new_node;
+  // the node stored with the best g, the board must be present
+  uint32_t node(const PackedBoard<W> &board) const {
+    return best_node[find_slot(board)];
   }
+
+  size_t size() const { return count; }
 };
 
 bool valid(int zr, int zc, int dir, int ro, int co) {
@@ -142,142 +238,2904 @@ bool valid(int zr, int zc, int dir, int ro, int co) {
   return false;
 }
 
-bool solvable(const vector<vector<int>> &grid, int zr) {
-  int inversions = 0;
+// index of m distinct cells out of n in the mixed radix n, n - 1, ...,
+// n - m + 1, where each digit is the cell's rank among the cells not used yet
+uint64_t rank_cells(const int *cells, int m, int n) {
+  uint64_t r = 0;
+  for (int i = 0; i < m; i++) {
+    int smaller = 0;
+    for (int j = 0; j < i; j++) {
+      if (cells[j] < cells[i]) smaller++;
+    }
+    r = r * (n - i) + cells[i] - smaller;
+  }
+  return r;
+}
 
-  vector<int> temp;
-  for (int i = 0; i < grid.size(); i++) {
-    temp.insert(temp.end(), grid[i].begin(), grid[i].end());
+void unrank_cells(uint64_t r, int m, int n, int *cells) {
+  int digit[64];
+  for (int i = m - 1; i >= 0; i--) {
+    digit[i] = r % (n - i);
+    r /= n - i;
   }
 
-  for (int i = 0; i < temp.size(); i++) {
-    for (int j = i + 1; j < temp.size(); j++) {
-      if (temp[i] && temp[j] && temp[i] > temp[j]) inversions++;
+  uint64_t used = 0;  // n <= 64
+  for (int i = 0; i < m; i++) {
+    int c = 0;
+    for (int left = digit[i];; c++) {
+      if (used >> c & 1) continue;
+      if (!left--) break;
     }
+    cells[i] = c;
+    used |= 1ULL << c;
   }
+}
 
-  if (grid.size() % 2) {
-    // if odd, then number of inversions must be even
-    return inversions % 2 == 0;
-  }
+// n * (n - 1) * ... * (n - m + 1)
+uint64_t placements(int n, int m) {
+  uint64_t r = 1;
+  for (int i = 0; i < m; i++) r *= n - i;
+  return r;
+}
 
-  else {
-    int diff = grid.size() - zr;
-    return diff % 2 != inversions % 2;
+// additive disjoint pattern database. the tiles are split into disjoint
+// patterns and for every placement of a pattern's tiles the table holds the
+// fewest moves of those tiles (other tiles are free to move) needed to put
+// them in their goal cells. since no move is counted by two patterns, the
+// sum over patterns is admissible.
+//
+// file layout: "NPDB", k, number of patterns, then for each pattern its size
+// and tiles (all uint32_t), then the tables one after another, one byte per
+// entry indexed by rank_cells() of the tiles' cells. the file is mapped
+// read-only, so a lookup is a rank computation and one byte load.
+class PatternDatabase {
+  int k = 0;
+  vector<vector<int>> patterns;
+  vector<int> pattern_of_tile;
+  vector<const uint8_t *> tables;
+  void *mapped = nullptr;
+  size_t mapped_size = 0;
+
+  enum : uint8_t { UNSEEN = 0x7f, EXPANDED = 0x80 };
+
+  // breadth first search over (pattern cells, blank cell) states back from
+  // the goal. moving a pattern tile costs 1 and moving any other tile is
+  // free, so each layer d is first closed under free moves before layer d + 1
+  // is expanded.
+  static vector<uint8_t> build_table(int k, const vector<int> &tiles) {
+    int n = k * k, m = tiles.size();
+    uint64_t states = placements(n, m + 1);
+    vector<uint8_t> dist(states, UNSEEN);
+
+    int cells[65], owner[64];
+    for (int i = 0; i < m; i++) cells[i] = tiles[i] - 1;
+    cells[m] = n - 1;
+    dist[rank_cells(cells, m + 1, n)] = 0;
+
+    vector<uint64_t> st;
+    for (int d = 0;; d++) {
+      bool any = false;
+
+      for (uint64_t idx = 0; idx < states; idx++) {
+        if (dist[idx] != d) continue;
+        any = true;
+        st.push_back(idx);
+
+        while (!st.empty()) {
+          uint64_t s = st.back();
+          st.pop_back();
+          if (dist[s] & EXPANDED) continue;
+          dist[s] |= EXPANDED;
+
+          unrank_cells(s, m + 1, n, cells);
+          fill(owner, owner + n, -1);
+          for (int i = 0; i < m; i++) owner[cells[i]] = i;
+
+          int blank = cells[m], br = blank / k, bc = blank % k;
+          for (int dir = 0; dir < 4; dir++) {
+            if (!valid(br, bc, dir, k, k)) continue;
+            int c = blank + (dir == 0 ? -1 : dir == 1 ? 1 : dir == 2 ? -k : k);
+
+            cells[m] = c;
+            if (owner[c] == -1) {
+              uint64_t t = rank_cells(cells, m + 1, n);
+              if ((dist[t] & UNSEEN) > d) {
+                dist[t] = d;
+                st.push_back(t);
+              }
+            } else {
+              cells[owner[c]] = blank;
+              uint64_t t = rank_cells(cells, m + 1, n);
+              if (dist[t] == UNSEEN) dist[t] = d + 1;
+              cells[owner[c]] = c;
+            }
+            cells[m] = blank;
+          }
+        }
+      }
+
+      if (!any) break;
+    }
+
+    // the blank cell is the last digit, so every placement of the pattern
+    // owns a run of n - m consecutive states
+    vector<uint8_t> table(placements(n, m));
+    for (uint64_t i = 0; i < table.size(); i++) {
+      uint8_t best = UNSEEN;
+      for (int b = 0; b < n - m; b++) {
+        best = min<uint8_t>(best, dist[i * (n - m) + b] & UNSEEN);
+      }
+      table[i] = best;
+    }
+    return table;
   }
-}
 
-class Compare {
  public:
-  int type;  // 0 for hamming, 1 for manhattan
-  Compare(int type = 1) : type(type) {}
-  bool operator()(Node *a, Node *b) const {
-    // since we want smallest first, we reverse the comparison (we overload >
-    // instead of <)
-    if (!type) {
-      assert(a->hamming_dist != -1 && b->hamming_dist != -1);
-      return a->hamming_dist + a->moves > b->hamming_dist + b->moves;
-    } else {
-      assert(a->manhattan_dist != -1 && b->manhattan_dist != -1);
-      return a->manhattan_dist + a->moves > b->manhattan_dist + b->moves;
+  PatternDatabase() = default;
+  PatternDatabase(const PatternDatabase &) = delete;
+  PatternDatabase &operator=(const PatternDatabase &) = delete;
+
+  ~PatternDatabase() {
+    if (mapped) munmap(mapped, mapped_size);
+  }
+
+  int size() const { return k; }
+  int pattern_of(int tile) const { return pattern_of_tile[tile]; }
+
+  // tile_pos[t] is the cell of tile t
+  int lookup(int p, const int *tile_pos) const {
+    int cells[64];
+    for (int i = 0; i < (int)patterns[p].size(); i++) {
+      cells[i] = tile_pos[patterns[p][i]];
     }
+    return tables[p][rank_cells(cells, patterns[p].size(), k * k)];
   }
-};
 
-void A_star(Node *start, bool manhattan) {
-  Compare comp(manhattan);
-  priority_queue<Node *, vector<Node *>, Compare> pq(comp);
-  set<vector<vector<int>>> visited;
-  vector<Node *> pointer_to_be_deleted;
-  int expanded = 0;
+  int lookup_all(const int *tile_pos) const {
+    int dist = 0;
+    for (int p = 0; p < (int)patterns.size(); p++) dist += lookup(p, tile_pos);
+    return dist;
+  }
 
-  pq.push(start);
-  int explored = 1;
-  bool flag = true;
+  // tiles 1, 2, ... are handed out to the patterns in order of their sizes,
+  // e.g. "6-6-3" for the 15-puzzle. returns an empty list if the sizes do
+  // not cover every tile exactly once.
+  static vector<vector<int>> parse_partition(const string &spec, int k) {
+    vector<vector<int>> parts;
+    int tile = 1;
+    stringstream ss(spec);
+    string size;
+    while (getline(ss, size, '-')) {
+      int m = atoi(size.c_str());
+      if (m <= 0 || tile + m > k * k) return {};
+      parts.emplace_back();
+      for (int i = 0; i < m; i++) parts.back().push_back(tile++);
+    }
+    if (tile != k * k) return {};
+    return parts;
+  }
 
-  while (flag) {
-    Node *cur = pq.top();
-    pq.pop();
-    expanded++;
-    visited.insert(cur->grid);
-    pointer_to_be_deleted.push_back(cur);
+  // the largest patterns whose (pattern, blank) search space still fits in a
+  // few hundred megabytes
+  static string default_partition(int k) {
+    int group = k <= 3 ? 4 : k == 4 ? 6 : k == 5 ? 5 : 4;
+    string spec;
+    for (int left = k * k - 1; left > 0; left -= group) {
+      if (!spec.empty()) spec += "-";
+      spec += to_string(min(group, left));
+    }
+    return spec;
+  }
 
-    for (int dir = 0; dir < 4; dir++) {
-      if (!valid(cur->zr, cur->zc, dir, cur->grid.size(), cur->grid[0].size()))
-        continue;
+  static bool build(int k, const vector<vector<int>> &parts,
+                    const string &path) {
+    ofstream out(path, ios::binary);
+    if (!out) return false;
 
-      Node *new_node = cur->make_move(dir);
-      if (visited.count(new_node->grid)) {
-        delete new_node;
-        continue;
-      }
+    auto put = [&](uint32_t x) { out.write((const char *)&x, sizeof(x)); };
+    out.write("NPDB", 4);
+    put(k);
+    put(parts.size());
+    for (const vector<int> &tiles : parts) {
+      put(tiles.size());
+      for (int t : tiles) put(t);
+    }
 
-      if (new_node->hamming_dist == 0 && new_node->manhattan_dist == 0) {
-        cout << "\nNumber of nodes explored = " << explored << "\n";
-        cout << "Number of nodes expanded = " << expanded << "\n";
-        cout << "Minimum number of moves = " << new_node->moves << "\n\n";
+    for (const vector<int> &tiles : parts) {
+      vector<uint8_t> table = build_table(k, tiles);
+      out.write((const char *)table.data(), table.size());
+    }
+    return (bool)out;
+  }
 
-        stack<Node *> st;
-        Node *last = new_node;
+  // the board size of a database file, 0 if there is none at path
+  static int file_size(const string &path) {
+    ifstream in(path, ios::binary);
+    char magic[4];
+    uint32_t file_k = 0;
+    if (!in.read(magic, 4) || memcmp(magic, "NPDB", 4) ||
+        !in.read((char *)&file_k, 4) || file_k > 8) {
+      return 0;
+    }
+    return file_k;
+  }
 
-        while (new_node->parent != nullptr) {
-          st.push(new_node);
-          new_node = new_node->parent;
-        }
+  bool load(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 12) {
+      close(fd);
+      return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return false;
+    mapped = p;
+    mapped_size = st.st_size;
 
-        st.push(new_node);
+    const uint8_t *data = (const uint8_t *)p, *end = data + mapped_size;
+    auto get = [&](uint32_t &x) {
+      if (end - data < 4) return false;
+      memcpy(&x, data, 4);
+      data += 4;
+      return true;
+    };
 
-        while (!st.empty()) {
-          cout << *(st.top()) << "\n";
-          st.pop();
+    uint32_t magic, file_k, count;
+    if (!get(magic) || memcmp(&magic, "NPDB", 4) || !get(file_k) ||
+        !get(count) || file_k < 2 || file_k > 8) {
+      return false;
+    }
+    k = file_k;
+    patterns.assign(count, {});
+    pattern_of_tile.assign(k * k, -1);
+    for (uint32_t p = 0; p < count; p++) {
+      uint32_t m, t;
+      if (!get(m) || m == 0 || m >= (uint32_t)k * k) return false;
+      for (uint32_t i = 0; i < m; i++) {
+        if (!get(t) || t == 0 || t >= (uint32_t)k * k ||
+            pattern_of_tile[t] != -1) {
+          return false;
         }
+        patterns[p].push_back(t);
+        pattern_of_tile[t] = p;
+      }
+    }
+    for (int t = 1; t < k * k; t++) {
+      if (pattern_of_tile[t] == -1) return false;
+    }
 
-        delete last;
+    tables.clear();
+    for (const vector<int> &tiles : patterns) {
+      uint64_t entries = placements(k * k, tiles.size());
+      if ((uint64_t)(end - data) < entries) return false;
+      tables.push_back(data);
+      data += entries;
+    }
+    return data == end;
+  }
+};
 
-        flag = false;
-        break;
+// one per board size, shared by every search once main() has loaded it
+PatternDatabase *pattern_db[9] = {};
+
+// nodes of a search live in fixed-size chunks and are addressed by a 32-bit
+// index (chunk << CHUNK_BITS | slot). chunks never move, so references stay
+// valid while the arena grows, and nothing is freed one node at a time:
+// clear() drops every node at once and keeps the chunks for the next search.
+template <class T>
+class Arena {
+  static_assert(is_trivially_destructible<T>::value,
+                "arena nodes are dropped without running destructors");
+  static const int CHUNK_BITS = 16;
+  static const uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+
+  vector<T *> chunks;
+  uint32_t used = 0;
+
+ public:
+  static const uint32_t NONE = UINT32_MAX;
+
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() {
+    for (T *chunk : chunks) ::operator delete(chunk);
+  }
+
+  uint32_t push(const T &value) {
+    assert(used < NONE);
+    if ((used >> CHUNK_BITS) == chunks.size()) {
+      chunks.push_back((T *)::operator new(sizeof(T) * CHUNK_SIZE));
+    }
+    new (&(*this)[used]) T(value);
+    return used++;
+  }
+
+  T &operator[](uint32_t i) {
+    return chunks[i >> CHUNK_BITS][i & (CHUNK_SIZE - 1)];
+  }
+  const T &operator[](uint32_t i) const {
+    return chunks[i >> CHUNK_BITS][i & (CHUNK_SIZE - 1)];
+  }
+
+  uint32_t size() const { return used; }
+  void clear() { used = 0; }
+};
+
+template <int W>
+ostream &print_board(ostream &os, const PackedBoard<W> &board, int k) {
+  for (int i = 0; i < k; i++) {
+    for (int j = 0; j < k; j++) {
+      os << board.get(i * k + j);
+      os << " ";
+    }
+    os << "\n";
+  }
+  return os;
+}
+
+// a board of width K. the width is a template parameter so that every loop
+// over the board has a constant bound and the geometry comes from tables.
+template <int K>
+struct Node {
+ public:
+  enum : int { k = K, W = words_for(K) };
+
+  PackedBoard<W> board;
+  uint32_t parent = Arena<Node>::NONE;  // index in the search's arena
+  int moves = 0, hamming_dist = -1, manhattan_dist = -1;
+  // only tracked when the search uses them, see slide()
+  int linear_conflicts = -1, pdb_dist = -1;
+  int zr = 0, zc = 0;
+
+  // start node. heuristic is the one the search will use, as in Compare
+  Node(const vector<vector<int>> &grid, int heuristic = 1) {
+    assert((int)grid.size() == k);
+    for (int i = 0; i < k; i++) {
+      for (int j = 0; j < k; j++) {
+        board.set(i * k + j, grid[i][j]);
+        if (!grid[i][j]) {
+          zr = i;
+          zc = j;
+        }
       }
+    }
 
-      else {
-        pq.push(new_node);
-        explored++;
+    hamming_dist = this->hamming_distance();
+    manhattan_dist = this->manhattan_distance();
+    if (heuristic == 2) linear_conflicts = this->linear_conflict();
+    if (heuristic == 3) pdb_dist = this->pattern_database_distance();
+  }
+
+  int hamming_distance() const {
+    int dist = 0;
+
+    for (int pos = 0; pos < k * k; pos++) {
+      int tile = board.get(pos);
+      if (tile && tile != pos + 1) dist++;
+    }
+
+    return dist;
+  }
+
+  int manhattan_distance() const {
+    int dist = 0;
+
+    for (int pos = 0; pos < k * k; pos++) {
+      int tile = board.get(pos);
+      if (tile) dist += geometry<K>.distance[tile][pos];
+    }
+
+    return dist;
+  }
+
+  // tiles that sit in their goal row (or column) but in the wrong order must
+  // step out of the line and back in, two moves more than manhattan counts.
+  // the fewest tiles that have to leave is the line length minus the longest
+  // increasing run of goal positions.
+  int line_conflict(int line, bool column) const {
+    int goal[8], lis[8], n = 0, longest = 0;  // k <= 8
+
+    for (int i = 0; i < k; i++) {
+      int tile = board.get(column ? i * k + line : line * k + i);
+      if (!tile) continue;
+      int actual_row = geometry<K>.goal_row[tile];
+      int actual_col = geometry<K>.goal_col[tile];
+      if (column && actual_col == line) goal[n++] = actual_row;
+      if (!column && actual_row == line) goal[n++] = actual_col;
+    }
+
+    for (int i = 0; i < n; i++) {
+      lis[i] = 1;
+      for (int j = 0; j < i; j++) {
+        if (goal[j] < goal[i]) lis[i] = max(lis[i], lis[j] + 1);
       }
+      longest = max(longest, lis[i]);
     }
+
+    return 2 * (n - longest);
   }
 
-  while (!pq.empty()) {
-    delete pq.top();
-    pq.pop();
+  int linear_conflict() const {
+    int dist = 0;
+    for (int i = 0; i < k; i++) {
+      dist += line_conflict(i, false) + line_conflict(i, true);
+    }
+    return dist;
+  }
+
+  void tile_positions(int *tile_pos) const {
+    for (int pos = 0; pos < k * k; pos++) tile_pos[board.get(pos)] = pos;
+  }
+
+  int pattern_database_distance() const {
+    assert(pattern_db[k]);
+    int tile_pos[64];
+    tile_positions(tile_pos);
+    return pattern_db[k]->lookup_all(tile_pos);
+  }
+
+  int heuristic(int type) const {
+    // 0 for hamming, 1 for manhattan, 2 for manhattan + linear conflict,
+    // 3 for the pattern database
+    if (!type) return hamming_dist;
+    if (type == 1) return manhattan_dist;
+    if (type == 2) {
+      assert(linear_conflicts != -1);
+      return manhattan_dist + linear_conflicts;
+    }
+    assert(pdb_dist != -1);
+    return pdb_dist;
+  }
+
+  friend ostream &operator<<(ostream &os, const Node &node) {
+    return print_board(os, node.board, node.k);
+  }
+
+  vector<int> tiles() const {
+    vector<int> tiles(k * k);
+    for (int pos = 0; pos < k * k; pos++) tiles[pos] = board.get(pos);
+    return tiles;
+  }
+
+  bool operator==(const Node &node) const { return board == node.board; }
+
+  bool can_slide(int dir) const {
+    return geometry<K>.neighbor[zr * k + zc][dir] != -1;
+  }
+
+  // moves the blank in place. only one tile changes position, so the
+  // heuristics are updated by its displacement instead of being recomputed;
+  // linear conflicts only change in the two rows (vertical move) or columns
+  // (horizontal move) that the tile leaves and enters, and the pattern
+  // database only in the moved tile's pattern.
+  void slide(int dir) {
+    // dir 0, 1, 2, 3 for left, right, up, down respectively
+    const Geometry<K> &geo = geometry<K>;
+    int to = zr * k + zc, from = geo.neighbor[to][dir];
+    assert(from != -1);
+    int nr = geo.row[from], nc = geo.col[from];
+
+    int tile = board.get(from);
+    bool column = nr == zr;
+    int old_line = column ? nc : nr, new_line = column ? zc : zr;
+
+    if (linear_conflicts != -1) {
+      linear_conflicts -=
+          line_conflict(old_line, column) + line_conflict(new_line, column);
+    }
+
+    if (pdb_dist != -1) {
+      const PatternDatabase &db = *pattern_db[k];
+      int tile_pos[64], p = db.pattern_of(tile);
+      tile_positions(tile_pos);
+      pdb_dist -= db.lookup(p, tile_pos);
+      tile_pos[tile] = to;
+      pdb_dist += db.lookup(p, tile_pos);
+    }
+
+    hamming_dist += (tile != to + 1) - (tile != from + 1);
+    manhattan_dist += geo.distance[tile][to] - geo.distance[tile][from];
+
+    // the blank always holds 0, so a swap is just moving the tile over
+    board.set(to, tile);
+    board.set(from, 0);
+    zr = nr;
+    zc = nc;
+
+    if (linear_conflicts != -1) {
+      linear_conflicts +=
+          line_conflict(old_line, column) + line_conflict(new_line, column);
+    }
+  }
+
+  // self is this node's index in the arena
+  Node make_move(int dir, uint32_t self) const {
+    Node new_node = *this;
+    new_node.parent = self;
+    new_node.moves = moves + 1;
+    new_node.slide(dir);
+
+    return new_node;
+  }
+};
+
+bool solvable(const vector<vector<int>> &grid, int zr) {
+  int inversions = 0;
+
+  vector<int> temp;
+  for (int i = 0; i < grid.size(); i++) {
+    temp.insert(temp.end(), grid[i].begin(), grid[i].end());
+  }
+
+  for (int i = 0; i < temp.size(); i++) {
+    for (int j = i + 1; j < temp.size(); j++) {
+      if (temp[i] && temp[j] && temp[i] > temp[j]) inversions++;
+    }
+  }
+
+  if (grid.size() % 2) {
+    // if odd, then number of inversions must be even
+    return inversions % 2 == 0;
   }
-  for (auto it : pointer_to_be_deleted) {
-    delete it;
+
+  else {
+    int diff = grid.size() - zr;
+    return diff % 2 != inversions % 2;
   }
 }
 
-int main() {
-  int k;
-  cin >> k;
+// open addressing (linear probing) table that keeps, for every board
+// generated by a search, the arena index of the node that reached it with
+// the fewest moves. a slot is just that 4-byte index; the board and g are
+// read from the arena, so each board is stored once, in its node.
+template <int K>
+class BestNodeTable {
+  enum : int { W = words_for(K) };
+  enum : uint32_t { NONE = Arena<Node<K>>::NONE };
 
-  vector<vector<int>> grid(k, vector<int>(k, 0));
-  int zr = 0;
+  const Arena<Node<K>> &arena;
+  vector<uint32_t> slots;
+  size_t count = 0;
 
-  for (int i = 0; i < k; i++) {
-    for (int j = 0; j < k; j++) {
-      cin >> grid[i][j];
-      if (grid[i][j] == 0) zr = i;
+  size_t find_slot(const PackedBoard<W> &board) const {
+    size_t mask = slots.size() - 1;
+    size_t i = board.hash() & mask;
+    while (slots[i] != NONE && !(arena[slots[i]].board == board)) {
+      i = (i + 1) & mask;
     }
+    return i;
   }
 
-  if (!solvable(grid, zr)) {
-    cout << "Not solvable\n";
-    return 0;
+  void grow() {
+    vector<uint32_t> old(slots.size() * 2, NONE);
+    old.swap(slots);
+    for (uint32_t idx : old) {
+      if (idx != NONE) slots[find_slot(arena[idx].board)] = idx;
+    }
+  }
+
+ public:
+  BestNodeTable(const Arena<Node<K>> &arena, size_t capacity = 1 << 16)
+      : arena(arena) {
+    size_t n = 1;
+    while (n < capacity) n <<= 1;
+    slots.assign(n, NONE);
+  }
+
+  // the node kept for the board, NONE if it was never generated
+  uint32_t find(const PackedBoard<W> &board) const {
+    return slots[find_slot(board)];
   }
 
-  Node *start = new Node(grid, nullptr);
-  cout << "Using Manhattan distance\n";
-  A_star(start, true);
+  // keeps the node at idx for its board, replacing any node kept before
+  void put(uint32_t idx) {
+    if (2 * (count + 1) > slots.size()) grow();
+    uint32_t &slot = slots[find_slot(arena[idx].board)];
+    if (slot == NONE) count++;
+    slot = idx;
+  }
 
-  //   start = new Node(grid, nullptr);
-  //   cout << "\n\nUsing Hamming distance\n";
-  //   A_star(start, false);
-}
\ No newline at end of file
+  // forgets every board but keeps the slots for the next search. it has to
+  // run before the arena is cleared: when few of the slots were used, only
+  // the run of slots from each node's home slot to the next free one is
+  // wiped, which covers every board kept (they sit between their home and
+  // the end of its run).
+  void clear() {
+    if (8 * (size_t)arena.size() < slots.size()) {
+      size_t mask = slots.size() - 1;
+      for (uint32_t idx = 0; idx < arena.size(); idx++) {
+        for (size_t i = arena[idx].board.hash() & mask; slots[i] != NONE;
+             i = (i + 1) & mask) {
+          slots[i] = NONE;
+        }
+      }
+    } else {
+      fill(slots.begin(), slots.end(), (uint32_t)NONE);
+    }
+    count = 0;
+  }
+
+  size_t size() const { return count; }
+};
+
+// the nodes and the best node table of an A* search. the server keeps one
+// per board size so that later searches reuse the memory of earlier ones.
+template <int K>
+struct AStarMemory {
+  Arena<Node<K>> arena;
+  BestNodeTable<K> best;
+
+  AStarMemory() : best(arena) {}
+
+  void clear() {
+    best.clear();
+    arena.clear();
+  }
+};
+
+template <int K>
+class Compare {
+ public:
+  int type;  // 0 hamming, 1 manhattan, 2 linear conflict, 3 pattern database
+  const Arena<Node<K>> *arena;
+  double weight;  // on the heuristic, above 1 for weighted A*
+  Compare(int type = 1, const Arena<Node<K>> *arena = nullptr,
+          double weight = 1)
+      : type(type), arena(arena), weight(weight) {}
+  bool operator()(const Node<K> *a, const Node<K> *b) const {
+    // since we want smallest first, we reverse the comparison (we overload >
+    // instead of <)
+    if (weight == 1) {
+      return a->heuristic(type) + a->moves > b->heuristic(type) + b->moves;
+    }
+    return weight * a->heuristic(type) + a->moves >
+           weight * b->heuristic(type) + b->moves;
+  }
+  bool operator()(uint32_t a, uint32_t b) const {
+    return (*this)(&(*arena)[a], &(*arena)[b]);
+  }
+
+  int g(uint32_t i) const { return (*arena)[i].moves; }
+  int f(uint32_t i) const { return g(i) + (*arena)[i].heuristic(type); }
+};
+
+// open list for integer f values: one bucket per (f, g), lowest f first,
+// then highest g so that deeper nodes (closer to the goal) go first, and
+// last in first out inside a bucket. push is O(1) and pop is O(1) apart
+// from stepping over empty buckets. same interface as the priority_queue.
+template <int K>
+class BucketQueue {
+  Compare<K> comp;
+  vector<vector<vector<uint32_t>>> buckets;  // [f][g]
+  vector<size_t> f_count;
+  int min_f = 0, top_g = -1;  // top_g is only kept up to date for min_f
+  size_t count = 0;
+
+  void settle() {
+    while (!f_count[min_f]) min_f++;
+    if (top_g == -1) top_g = buckets[min_f].size() - 1;
+    while (buckets[min_f][top_g].empty()) top_g--;
+  }
+
+ public:
+  BucketQueue(const Compare<K> &comp) : comp(comp) {}
+
+  void push(uint32_t i) {
+    int f = comp.f(i), g = comp.g(i);
+    if (f >= (int)buckets.size()) {
+      buckets.resize(f + 1);
+      f_count.resize(f + 1);
+    }
+    if (g >= (int)buckets[f].size()) buckets[f].resize(g + 1);
+    buckets[f][g].push_back(i);
+    f_count[f]++;
+
+    if (!count || f < min_f) {
+      min_f = f;
+      top_g = g;
+    } else if (f == min_f && g > top_g) {
+      top_g = g;
+    }
+    count++;
+  }
+
+  uint32_t top() {
+    settle();
+    return buckets[min_f][top_g].back();
+  }
+
+  void pop() {
+    settle();
+    buckets[min_f][top_g].pop_back();
+    f_count[min_f]--;
+    count--;
+    if (!f_count[min_f]) top_g = -1;
+  }
+
+  bool empty() const { return !count; }
+  size_t size() const { return count; }
+};
+
+// what A* collects for --stats on top of the counters in SearchResult
+struct SearchStats {
+  enum Work { EXPANSION, HEURISTIC, QUEUE };
+
+  struct Snapshot {
+    double seconds;
+    long long explored, expanded;
+    size_t open, generated;  // generated counts distinct boards
+    int min_f;
+  };
+
+  bool collected = false;
+  // boards only leave the best node table when the search ends, so its
+  // size at the end is the number of distinct boards generated
+  size_t peak_open = 0, generated_states = 0;
+  long long heuristic_evaluations = 0;
+  double seconds[3] = {};  // per Work
+  vector<Snapshot> snapshots;
+};
+
+// charges the time since the previous lap to a kind of work. reading the
+// clock costs about as much as a queue operation, so it is only done when
+// the stats were asked for.
+class LapTimer {
+  SearchStats *stats;
+  chrono::steady_clock::time_point last = chrono::steady_clock::now();
+
+ public:
+  LapTimer(SearchStats *stats) : stats(stats) {}
+
+  void lap(SearchStats::Work work) {
+    if (!stats) return;
+    auto now = chrono::steady_clock::now();
+    stats->seconds[work] += chrono::duration<double>(now - last).count();
+    last = now;
+  }
+};
+
+struct SearchResult {
+  long long explored = 0, expanded = 0;
+  long long runs_written = 0;  // by --external
+  string error;  // set if the search could not finish, e.g. on I/O errors
+  int moves = -1;
+  double bound = 1;  // moves is at most this times the minimum
+  vector<vector<int>> path;  // boards from the start to the goal, row-major
+  SearchStats stats;
+};
+
+void print_result(const SearchResult &result, int k) {
+  cout << "\nNumber of nodes explored = " << result.explored << "\n";
+  cout << "Number of nodes expanded = " << result.expanded << "\n";
+  if (result.bound > 1) {
+    cout << "Number of moves = " << result.moves << ", at most "
+         << setprecision(2) << fixed << result.bound
+         << " times the minimum\n\n" << defaultfloat;
+  } else if (result.moves == -1) {
+    cout << "No path found in time\n\n";
+  } else {
+    cout << "Minimum number of moves = " << result.moves << "\n\n";
+  }
+
+  for (const vector<int> &tiles : result.path) {
+    for (int i = 0; i < k; i++) {
+      for (int j = 0; j < k; j++) {
+        cout << tiles[i * k + j];
+        cout << " ";
+      }
+      cout << "\n";
+    }
+    cout << "\n";
+  }
+}
+
+template <int K>
+void collect_path(const Arena<Node<K>> &arena, uint32_t last,
+                  SearchResult &result) {
+  stack<uint32_t> st;
+  for (uint32_t i = last; i != Arena<Node<K>>::NONE; i = arena[i].parent) {
+    st.push(i);
+  }
+
+  while (!st.empty()) {
+    result.path.push_back(arena[st.top()].tiles());
+    st.pop();
+  }
+}
+
+// OpenList is priority_queue<uint32_t, vector<uint32_t>, Compare<K>> or
+// BucketQueue<K>. result.stats is filled in when snapshot_interval > 0,
+// with a snapshot of the frontier about every snapshot_interval seconds.
+// memory is cleared and reused if given, otherwise the search has its own.
+template <int K, class OpenList>
+SearchResult A_star(const Node<K> &start, int heuristic,
+                    double snapshot_interval = 0,
+                    AStarMemory<K> *memory = nullptr) {
+  unique_ptr<AStarMemory<K>> own;
+  if (!memory) {
+    own.reset(new AStarMemory<K>);
+    memory = own.get();
+  }
+  memory->clear();
+
+  // every node of the search, freed all at once when it returns
+  Arena<Node<K>> &arena = memory->arena;
+  Compare<K> comp(heuristic, &arena);
+  OpenList pq(comp);
+  // best node of every generated board, so a board is only queued again
+  // when it is reached with fewer moves
+  BestNodeTable<K> &best = memory->best;
+  SearchResult result;
+  long long &explored = result.explored, &expanded = result.expanded;
+  SearchStats &stats = result.stats;
+  stats.collected = snapshot_interval > 0;
+  LapTimer timer(stats.collected ? &stats : nullptr);
+  auto begin = chrono::steady_clock::now();
+  double next_snapshot = snapshot_interval;
+
+  pq.push(arena.push(start));
+  best.put(0);
+  explored = 1;
+  stats.heuristic_evaluations = 1;
+  bool flag = true;
+
+  if (start.hamming_dist == 0 && start.manhattan_dist == 0) {
+    result.moves = start.moves;
+    result.path.push_back(start.tiles());
+    flag = false;
+  }
+
+  while (flag) {
+    if (stats.collected) {
+      stats.peak_open = max(stats.peak_open, pq.size());
+      if ((expanded & 4095) == 0) {
+        double secs = chrono::duration<double>(chrono::steady_clock::now() -
+                                               begin)
+                          .count();
+        if (secs >= next_snapshot) {
+          stats.snapshots.push_back({secs, explored, expanded, pq.size(),
+                                     best.size(), comp.f(pq.top())});
+          next_snapshot = secs + snapshot_interval;
+        }
+      }
+      timer.lap(SearchStats::EXPANSION);
+    }
+
+    uint32_t cur_idx = pq.top();
+    const Node<K> &cur = arena[cur_idx];
+    pq.pop();
+    timer.lap(SearchStats::QUEUE);
+    // a copy of this board with fewer moves was queued after this one
+    if (best.find(cur.board) != cur_idx) continue;
+    expanded++;
+
+    for (int dir = 0; dir < 4; dir++) {
+      if (!cur.can_slide(dir)) continue;
+
+      timer.lap(SearchStats::EXPANSION);
+      Node<K> new_node = cur.make_move(dir, cur_idx);
+      stats.heuristic_evaluations++;
+      timer.lap(SearchStats::HEURISTIC);
+      uint32_t old_idx = best.find(new_node.board);
+      if (old_idx != Arena<Node<K>>::NONE &&
+          arena[old_idx].moves <= new_node.moves) {
+        continue;
+      }
+
+      uint32_t new_idx = arena.push(new_node);
+      best.put(new_idx);
+
+      if (new_node.hamming_dist == 0 && new_node.manhattan_dist == 0) {
+        result.moves = new_node.moves;
+        collect_path(arena, new_idx, result);
+
+        flag = false;
+        break;
+      }
+
+      else {
+        timer.lap(SearchStats::EXPANSION);
+        pq.push(new_idx);
+        timer.lap(SearchStats::QUEUE);
+        explored++;
+      }
+    }
+  }
+
+  if (stats.collected) stats.generated_states = best.size();
+  return result;
+}
+
+// IDA*: depth first search on a single board that is modified in place and
+// restored after every move. each iteration is bounded by f = g + h <= limit,
+// and the next limit is the smallest f that went over the current one. memory
+// use is just the current path.
+template <int K>
+class IDA_star {
+  Node<K> cur;
+  int type;
+  vector<int> path;  // directions taken from the start, as in make_move
+  long long explored = 1, expanded = 0;
+
+  static const int FOUND = -1;
+
+  int search(int g, int limit) {
+    int h = cur.heuristic(type);
+    int f = g + h;
+    if (f > limit) return f;
+    if (cur.manhattan_dist == 0) return FOUND;
+
+    expanded++;
+    int next_limit = INT_MAX;
+    int prev = path.empty() ? -1 : path.back();
+
+    for (int dir = 0; dir < 4; dir++) {
+      if (!cur.can_slide(dir)) continue;
+      // left/right and up/down are pairs 0/1 and 2/3, so this skips the move
+      // that undoes the previous one
+      if (prev != -1 && dir == (prev ^ 1)) continue;
+
+      explored++;
+      cur.slide(dir);
+      path.push_back(dir);
+
+      int t = search(g + 1, limit);
+      if (t == FOUND) return FOUND;
+      next_limit = min(next_limit, t);
+
+      path.pop_back();
+      cur.slide(dir ^ 1);
+    }
+
+    return next_limit;
+  }
+
+ public:
+  IDA_star(const Node<K> &start, int heuristic)
+      : cur(start), type(heuristic) {}
+
+  SearchResult run() {
+    int limit = cur.heuristic(type);
+    while (true) {
+      int t = search(0, limit);
+      if (t == FOUND) break;
+      limit = t;
+    }
+
+    SearchResult result;
+    result.explored = explored;
+    result.expanded = expanded;
+    result.moves = path.size();
+
+    // the search leaves the board at the goal, so replay the path from the
+    // start to record it
+    vector<int> moves;
+    moves.swap(path);
+    for (int i = (int)moves.size() - 1; i >= 0; i--) cur.slide(moves[i] ^ 1);
+
+    result.path.push_back(cur.tiles());
+    for (int dir : moves) {
+      cur.slide(dir);
+      result.path.push_back(cur.tiles());
+    }
+    return result;
+  }
+};
+
+// anytime repairing A* (ARA*): weighted A* on f = g + w * h quickly finds a
+// path of at most w times the minimum, then w is lowered by a step and the
+// search carries on from its open list instead of starting over. a board
+// whose moves improve after it was expanded in the current pass waits in
+// incons until the next pass. a pass ends once no open node can beat the
+// best path, which is then within min(w, cost / lowest g + h still open) of
+// the minimum. the search stops at the deadline or when that bound is 1.
+template <int K>
+class AnytimeSearch {
+  enum : uint32_t { NONE = Arena<Node<K>>::NONE };
+
+  Arena<Node<K>> arena;
+  BestNodeTable<K> best;
+  Compare<K> comp;
+  vector<uint32_t> open;    // heap ordered by comp
+  vector<uint32_t> incons;  // boards improved after they were closed
+  vector<int> closed;       // per node, pass its board was expanded in or -1
+  int pass = 0;
+  double step, time_limit;
+  ostream *log;
+  chrono::steady_clock::time_point begin;
+
+  uint32_t goal = NONE;
+  int cost = INT_MAX;
+  double bound = INFINITY;
+  int reported_cost = -1;
+  double reported = INFINITY;
+  long long explored = 1, expanded = 0;
+
+  double elapsed() const {
+    return chrono::duration<double>(chrono::steady_clock::now() - begin)
+        .count();
+  }
+
+  bool stale(uint32_t i) const { return best.find(arena[i].board) != i; }
+
+  // expands until the pass ends (true) or the deadline passes (false)
+  bool improve() {
+    while (!open.empty()) {
+      if ((expanded & 1023) == 0 && elapsed() > time_limit) return false;
+
+      uint32_t cur_idx = open.front();
+      const Node<K> &cur = arena[cur_idx];
+      if (cur.moves + comp.weight * cur.heuristic(comp.type) >= cost) break;
+      pop_heap(open.begin(), open.end(), comp);
+      open.pop_back();
+      if (stale(cur_idx)) continue;
+      closed[cur_idx] = pass;
+      expanded++;
+
+      for (int dir = 0; dir < 4; dir++) {
+        if (!cur.can_slide(dir)) continue;
+
+        Node<K> new_node = cur.make_move(dir, cur_idx);
+        // the heuristic is admissible, so this cannot lead to a shorter path
+        if (new_node.moves + new_node.heuristic(comp.type) >= cost) continue;
+        uint32_t old_idx = best.find(new_node.board);
+        if (old_idx != NONE && arena[old_idx].moves <= new_node.moves) {
+          continue;
+        }
+
+        uint32_t new_idx = arena.push(new_node);
+        best.put(new_idx);
+        explored++;
+        bool reopened = old_idx != NONE && closed[old_idx] == pass;
+        closed.push_back(reopened ? pass : -1);
+
+        if (new_node.manhattan_dist == 0) {
+          cost = new_node.moves;
+          goal = new_idx;
+        } else if (reopened) {
+          incons.push_back(new_idx);
+        } else {
+          open.push_back(new_idx);
+          push_heap(open.begin(), open.end(), comp);
+        }
+      }
+    }
+    return true;
+  }
+
+  // lowest g + h left to expand, a lower bound on the minimum
+  int lower_bound() const {
+    int lowest = cost;
+    for (const vector<uint32_t> *list : {&open, &incons}) {
+      for (uint32_t i : *list) {
+        if (!stale(i)) lowest = min(lowest, comp.f(i));
+      }
+    }
+    return lowest;
+  }
+
+  // only when the path or its bound got better
+  void report() {
+    if (!log || goal == NONE || (cost == reported_cost && bound == reported)) {
+      return;
+    }
+    reported_cost = cost;
+    reported = bound;
+    *log << "Found " << cost << " moves after " << fixed << setprecision(3)
+         << elapsed() << "s, at most " << setprecision(2) << bound
+         << " times the minimum" << defaultfloat << endl;
+  }
+
+ public:
+  // log gets a line for every pass that ends with a path, or nullptr
+  AnytimeSearch(int heuristic, double weight, double step, double time_limit,
+                ostream *log)
+      : best(arena),
+        comp(heuristic, &arena, weight),
+        step(step),
+        time_limit(time_limit),
+        log(log) {}
+
+  SearchResult run(const Node<K> &start) {
+    begin = chrono::steady_clock::now();
+    open.push_back(arena.push(start));
+    best.put(0);
+    closed.push_back(-1);
+    if (start.manhattan_dist == 0) {
+      goal = 0;
+      cost = 0;
+    }
+
+    while (true) {
+      bool done = improve();
+      if (goal != NONE) {
+        double proven = cost ? (double)cost / lower_bound() : 1;
+        bound = min(bound, done ? min(comp.weight, proven) : proven);
+      }
+      if (done) report();
+      if (!done || bound <= 1 || (goal == NONE && open.empty())) break;
+
+      // next pass: lower the weight and move the waiting boards back in
+      comp.weight = max(1.0, comp.weight - step);
+      pass++;
+      for (uint32_t i : incons) open.push_back(i);
+      incons.clear();
+      open.erase(remove_if(open.begin(), open.end(),
+                           [this](uint32_t i) { return stale(i); }),
+                 open.end());
+      make_heap(open.begin(), open.end(), comp);
+    }
+
+    SearchResult result;
+    result.explored = explored;
+    result.expanded = expanded;
+    if (goal != NONE) {
+      result.moves = cost;
+      result.bound = bound;
+      collect_path(arena, goal, result);
+    }
+    return result;
+  }
+};
+
+struct Options {
+  SearchMode mode = A_STAR_MODE;
+  int heuristic = 1;  // as in Compare
+  bool bucket_queue = false;
+  // 0 until main picks them: all cores for a single search, and in batch
+  // mode one thread per search and as many jobs as fit on the cores
+  int threads = 0, jobs = 0;
+  string pdb_path, pdb_partition, batch;
+  string external_dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  size_t memory_mb = 256;
+  double weight = 3, weight_step = 0.5, time_limit = 1;  // for ANYTIME_MODE
+  bool stats = false;
+  double stats_interval = 1;
+  bool serve = false;
+  string socket_path;  // serve on this unix socket instead of stdin
+  bool bench = false;
+  string bench_classes = "3:0,4:30,4:45,5:40";  // k:depth, 0 for random
+  string bench_solvers =
+      "astar:hamming,astar:manhattan,astar:linear,astar-buckets,ida,"
+      "ida:linear,hda,bidirectional,external,anytime";
+  int bench_count = 10, bench_timeout = 60;
+  unsigned bench_seed = 1;
+};
+
+const string heuristic_names[] = {"Hamming distance", "Manhattan distance",
+                                  "linear conflict", "pattern database"};
+
+// maps the pattern database named in the options, building and saving it
+// first if the file does not exist yet
+bool open_pattern_database(int k, const Options &opt) {
+  static PatternDatabase dbs[9];
+  PatternDatabase &db = dbs[k];
+  if (pattern_db[k]) return true;
+
+  // --pdb and --pdb-partition are only for the board size they fit, so a
+  // batch of mixed sizes uses the defaults for the others. a --pdb file
+  // that does not exist yet is built for the first size that needs it.
+  string path = "pdb" + to_string(k) + ".bin";
+  if (!opt.pdb_path.empty()) {
+    if (access(opt.pdb_path.c_str(), F_OK) != 0 ||
+        PatternDatabase::file_size(opt.pdb_path) == k) {
+      path = opt.pdb_path;
+    } else {
+      cerr << opt.pdb_path << " is not for " << k << "x" << k
+           << " boards, using " << path << "\n";
+    }
+  }
+
+  if (access(path.c_str(), F_OK) != 0) {
+    string spec = PatternDatabase::default_partition(k);
+    if (!opt.pdb_partition.empty()) {
+      if (!PatternDatabase::parse_partition(opt.pdb_partition, k).empty()) {
+        spec = opt.pdb_partition;
+      } else {
+        cerr << "Partition " << opt.pdb_partition << " does not fit " << k
+             << "x" << k << " boards, using " << spec << "\n";
+      }
+    }
+    vector<vector<int>> parts = PatternDatabase::parse_partition(spec, k);
+    if (parts.empty()) {
+      cerr << "Invalid pattern partition: " << spec << "\n";
+      return false;
+    }
+    cerr << "Building pattern database " << spec << " into " << path << "\n";
+    if (!PatternDatabase::build(k, parts, path)) {
+      cerr << "Could not write pattern database: " << path << "\n";
+      return false;
+    }
+  }
+
+  if (!db.load(path)) {
+    cerr << "Could not load pattern database: " << path << "\n";
+    return false;
+  }
+  if (db.size() != k) {
+    cerr << "Pattern database " << path << " is for " << db.size() << "x"
+         << db.size() << " boards\n";
+    return false;
+  }
+  pattern_db[k] = &db;
+  return true;
+}
+
+// hash distributed A*: every board has an owner thread picked by its hash,
+// and only the owner keeps it in its open and closed lists. a thread expands
+// its own best node and sends each child to the child's owner through that
+// thread's mailbox, so no lists are shared. nodes can now reach a board with
+// a smaller g after it was expanded, so the closed list keeps the best g and
+// such boards are reopened.
+//
+// the first goal found is not necessarily the cheapest, so it only becomes
+// the incumbent and the search goes on until no thread holds a node with
+// f < incumbent and no node is in flight. that is detected with two global
+// counters: a node is counted as sent before it enters a mailbox and as
+// received after the owner has put it in its open list. if every thread is
+// idle and sent == received, unchanged over the whole check, nothing can
+// wake anyone up again.
+template <int K>
+class HDA_star {
+  enum : int { W = words_for(K) };
+
+  struct Message {
+    Node<K> node;
+    int parent_thread;
+  };
+
+  // batches of messages pushed onto a lock-free stack, taken by the owner
+  // all at once
+  struct Batch {
+    Batch *next;
+    vector<Message> messages;
+  };
+
+  // an outbox is sent when it holds BATCH_SIZE messages, and all of them
+  // every FLUSH_EXPANSIONS expansions or when the f being expanded rises,
+  // so children with a low f (or the goal) do not wait in a buffer while
+  // their owner expands nodes it would not need
+  static const size_t BATCH_SIZE = 64;
+  static const int FLUSH_EXPANSIONS = 16;
+
+  struct Worker {
+    Arena<Node<K>> arena;
+    vector<int16_t> parent_thread;  // parallel to the arena, -1 for the start
+    StateMap<W> closed;
+    Compare<K> comp;
+    BucketQueue<K> open;
+    vector<vector<Message>> outbox;  // per destination thread
+    atomic<Batch *> mailbox{nullptr};
+    atomic<bool> idle{false};
+    long long explored = 0, expanded = 0;
+    int unflushed = 0;  // expansions since the outboxes were last sent
+    int last_f = 0;     // of the last node expanded
+
+    Worker(int type, int threads)
+        : comp(type, &arena), open(comp), outbox(threads) {}
+  };
+
+  int threads, type;
+  vector<unique_ptr<Worker>> workers;
+  atomic<long long> sent{0}, received{0};
+  atomic<bool> done{false};
+  atomic<int> incumbent{INT_MAX};
+  mutex incumbent_lock;
+  int goal_thread = -1;
+  uint32_t goal_index = 0;
+
+  int owner(const PackedBoard<W> &board) const {
+    // high bits, the low ones pick the slot in the owner's closed list
+    return (board.hash() >> 40) % threads;
+  }
+
+  void send(int from, int to) {
+    vector<Message> &out = workers[from]->outbox[to];
+    if (out.empty()) return;
+    Batch *batch = new Batch{nullptr, move(out)};
+    out.clear();
+    sent += batch->messages.size();
+
+    atomic<Batch *> &head = workers[to]->mailbox;
+    batch->next = head.load();
+    while (!head.compare_exchange_weak(batch->next, batch)) {
+    }
+  }
+
+  // keeps the node if it is the best way to its board seen so far
+  void receive(int me, const Message &msg) {
+    Worker &w = *workers[me];
+    const Node<K> &node = msg.node;
+    if (node.moves >= incumbent || !w.closed.improve(node.board, node.moves)) {
+      return;
+    }
+
+    uint32_t idx = w.arena.push(node);
+    w.parent_thread.push_back(msg.parent_thread);
+    w.explored++;
+
+    if (node.manhattan_dist == 0) {
+      lock_guard<mutex> lock(incumbent_lock);
+      if (node.moves < incumbent) {
+        incumbent = node.moves;
+        goal_thread = me;
+        goal_index = idx;
+      }
+      return;
+    }
+    w.open.push(idx);
+  }
+
+  bool drain_mailbox(int me) {
+    Worker &w = *workers[me];
+    if (!w.mailbox.load()) return false;
+
+    w.idle = false;
+    Batch *batch = w.mailbox.exchange(nullptr);
+    while (batch) {
+      for (const Message &msg : batch->messages) receive(me, msg);
+      received += batch->messages.size();
+      Batch *next = batch->next;
+      delete batch;
+      batch = next;
+    }
+    return true;
+  }
+
+  bool terminated() {
+    long long s = sent, r = received;
+    if (s != r) return false;
+    for (auto &w : workers) {
+      if (!w->idle) return false;
+    }
+    return s == sent && r == received;
+  }
+
+  void work(int me) {
+    Worker &w = *workers[me];
+
+    while (!done) {
+      drain_mailbox(me);
+
+      if (!w.open.empty() && w.comp.f(w.open.top()) < incumbent) {
+        uint32_t cur_idx = w.open.top();
+        w.open.pop();
+        const Node<K> &cur = w.arena[cur_idx];
+        // a cheaper copy of this board was queued after this one
+        if (w.closed.get(cur.board) < cur.moves) continue;
+        w.expanded++;
+
+        int f = w.comp.f(cur_idx);
+        if (w.unflushed >= FLUSH_EXPANSIONS || f > w.last_f) {
+          for (int to = 0; to < threads; to++) send(me, to);
+          w.unflushed = 0;
+          if (f > w.last_f) this_thread::yield();
+        }
+        w.unflushed++;
+        w.last_f = f;
+
+        for (int dir = 0; dir < 4; dir++) {
+          if (!cur.can_slide(dir)) continue;
+
+          Message msg{cur.make_move(dir, cur_idx), me};
+          int to = owner(msg.node.board);
+          if (to == me) {
+            receive(me, msg);
+          } else {
+            w.outbox[to].push_back(msg);
+            if (w.outbox[to].size() >= BATCH_SIZE) send(me, to);
+          }
+        }
+        continue;
+      }
+
+      // nothing worth expanding here, so hand out what is still buffered
+      // before going idle
+      for (int to = 0; to < threads; to++) send(me, to);
+      w.idle = true;
+      if (w.mailbox.load()) continue;
+      if (terminated()) done = true;
+      this_thread::yield();
+    }
+  }
+
+ public:
+  HDA_star(int heuristic, int threads) : threads(threads), type(heuristic) {
+    for (int i = 0; i < threads; i++) {
+      workers.emplace_back(new Worker(heuristic, threads));
+    }
+  }
+
+  SearchResult run(const Node<K> &start) {
+    receive(owner(start.board), Message{start, -1});
+
+    vector<thread> pool;
+    for (int i = 0; i < threads; i++) pool.emplace_back(&HDA_star::work, this, i);
+    for (thread &t : pool) t.join();
+
+    SearchResult result;
+    for (auto &w : workers) {
+      result.explored += w->explored;
+      result.expanded += w->expanded;
+    }
+    result.moves = incumbent;
+
+    stack<const Node<K> *> st;
+    int t = goal_thread;
+    for (uint32_t i = goal_index; t != -1;) {
+      const Node<K> &node = workers[t]->arena[i];
+      st.push(&node);
+      int parent_thread = workers[t]->parent_thread[i];
+      i = node.parent;
+      t = parent_thread;
+    }
+
+    while (!st.empty()) {
+      result.path.push_back(st.top()->tiles());
+      st.pop();
+    }
+    return result;
+  }
+};
+
+// bidirectional MM search: A* from the start towards the goal and from the
+// goal back towards the start, each with the manhattan distance to the board
+// it is heading for. a node's priority is max(f, 2g), so neither side goes
+// more than half way before the other. every generated board is looked up in
+// the other side's closed list and a hit gives a path (upper bound U); the
+// search stops once U <= the smallest priority left on either side, which
+// is a lower bound on the cost of any path not found yet.
+template <int K>
+class Bidirectional {
+  enum : int { k = K, W = words_for(K) };
+
+  struct BNode {
+    PackedBoard<W> board;
+    uint32_t parent;
+    int g, h, zr, zc;
+  };
+
+  struct Entry {
+    int pr, g;
+    uint32_t idx;
+    // smallest priority first, deeper nodes first among equals
+    bool operator<(const Entry &other) const {
+      return pr != other.pr ? pr > other.pr : g < other.g;
+    }
+  };
+
+  struct Side {
+    Arena<BNode> arena;
+    StateMap<W> closed;
+    priority_queue<Entry> open;
+    int target_row[64], target_col[64];  // where each tile is headed
+  };
+
+  Side sides[2];  // 0 searches forward from the start, 1 back from the goal
+  long long explored = 0, expanded = 0;
+  int best = INT_MAX;
+  uint32_t meet[2] = {Arena<BNode>::NONE, Arena<BNode>::NONE};
+  bool at_goal;  // the start is the goal, there is nothing to search
+
+  int manhattan(const Side &side, const PackedBoard<W> &board) const {
+    int dist = 0;
+    for (int pos = 0; pos < k * k; pos++) {
+      int tile = board.get(pos);
+      if (tile) {
+        dist += abs(geometry<K>.row[pos] - side.target_row[tile]) +
+                abs(geometry<K>.col[pos] - side.target_col[tile]);
+      }
+    }
+    return dist;
+  }
+
+  void add(int s, const BNode &node) {
+    Side &side = sides[s], &other = sides[s ^ 1];
+    if (!side.closed.improve(node.board, node.g, side.arena.size())) return;
+    uint32_t idx = side.arena.push(node);
+    side.open.push(Entry{max(node.g + node.h, 2 * node.g), node.g, idx});
+    explored++;
+
+    int g = other.closed.get(node.board);
+    if (g != INT_MAX && node.g + g < best) {
+      best = node.g + g;
+      meet[s] = idx;
+      meet[s ^ 1] = other.closed.node(node.board);
+    }
+  }
+
+  void expand(int s) {
+    Side &side = sides[s];
+    Entry e = side.open.top();
+    side.open.pop();
+    const BNode cur = side.arena[e.idx];
+    if (side.closed.get(cur.board) < cur.g) return;  // stale copy
+    expanded++;
+
+    for (int dir = 0; dir < 4; dir++) {
+      int from = geometry<K>.neighbor[cur.zr * k + cur.zc][dir];
+      if (from == -1) continue;
+      int nr = geometry<K>.row[from], nc = geometry<K>.col[from];
+      int tile = cur.board.get(from);
+      int tr = side.target_row[tile], tc = side.target_col[tile];
+
+      BNode next = cur;
+      next.parent = e.idx;
+      next.g = cur.g + 1;
+      next.h += abs(cur.zr - tr) + abs(cur.zc - tc) - abs(nr - tr) -
+                abs(nc - tc);
+      next.board.set(cur.zr * k + cur.zc, tile);
+      next.board.set(from, 0);
+      next.zr = nr;
+      next.zc = nc;
+      add(s, next);
+    }
+  }
+
+  int min_priority(int s) const {
+    return sides[s].open.empty() ? INT_MAX : sides[s].open.top().pr;
+  }
+
+ public:
+  Bidirectional(const Node<K> &start) {
+    Node<K> goal = start;
+    for (int pos = 0; pos < k * k; pos++) {
+      goal.board.set(pos, pos == k * k - 1 ? 0 : pos + 1);
+    }
+    goal.zr = goal.zc = k - 1;
+    at_goal = start.board == goal.board;
+    if (at_goal) {
+      sides[0].arena.push(BNode{start.board, Arena<BNode>::NONE, 0, 0,
+                                start.zr, start.zc});
+      best = 0;
+      meet[0] = 0;
+      return;
+    }
+
+    const Node<K> *ends[2] = {&goal, &start};  // side s heads for ends[s]
+    for (int s = 0; s < 2; s++) {
+      for (int pos = 0; pos < k * k; pos++) {
+        int tile = ends[s]->board.get(pos);
+        sides[s].target_row[tile] = pos / k;
+        sides[s].target_col[tile] = pos % k;
+      }
+    }
+
+    for (int s = 0; s < 2; s++) {
+      const Node<K> &from = *ends[s ^ 1];
+      BNode root{from.board, Arena<BNode>::NONE, 0, 0, from.zr, from.zc};
+      root.h = manhattan(sides[s], root.board);
+      add(s, root);
+    }
+  }
+
+  SearchResult run() {
+    while (!at_goal && best > min(min_priority(0), min_priority(1))) {
+      // the side with the smaller priority, forward on ties
+      expand(min_priority(0) <= min_priority(1) ? 0 : 1);
+    }
+
+    SearchResult result;
+    result.explored = explored;
+    result.expanded = expanded;
+    if (best == INT_MAX) return result;  // the sides never met
+    result.moves = best;
+
+    auto tiles = [&](const BNode &node) {
+      vector<int> tiles(k * k);
+      for (int pos = 0; pos < k * k; pos++) tiles[pos] = node.board.get(pos);
+      return tiles;
+    };
+
+    // start .. meeting board from the forward side, then the rest of the
+    // way from the backward side's parents
+    stack<uint32_t> st;
+    for (uint32_t i = meet[0]; i != Arena<BNode>::NONE;) {
+      st.push(i);
+      i = sides[0].arena[i].parent;
+    }
+    while (!st.empty()) {
+      result.path.push_back(tiles(sides[0].arena[st.top()]));
+      st.pop();
+    }
+    if (meet[1] == Arena<BNode>::NONE) return result;  // met at the start
+    for (uint32_t i = sides[1].arena[meet[1]].parent; i != Arena<BNode>::NONE;
+         i = sides[1].arena[i].parent) {
+      result.path.push_back(tiles(sides[1].arena[i]));
+    }
+    return result;
+  }
+};
+
+// external memory A* for boards whose search does not fit in RAM. states are
+// grouped into buckets by (g, h) and every bucket lives on disk. one move
+// changes the manhattan distance by exactly 1, so expanding bucket (g, h)
+// only writes to (g + 1, h - 1), which has the same f and comes next, and
+// to (g + 1, h + 1) in the next f layer. buckets are expanded by increasing
+// f, then increasing g.
+//
+// children are buffered in memory and written out as sorted runs: when the
+// buffers of all buckets together reach the --memory budget, the biggest
+// one is written. a layer can feed many buckets at once, so a per-bucket
+// limit would not bound the total. before a bucket is expanded its runs are
+// merged, at most 64 at a time (fewer if the open file limit is lower) and
+// in several passes if needed, into one sorted file, dropping
+// duplicates within the bucket and boards already in (g - 1, h) or
+// (g - 2, h): in an undirected graph with unit moves those are the only
+// layers a board reached at depth g can have been closed in before. every
+// record keeps the move that produced it, so the path is rebuilt at the end
+// by undoing moves and binary searching each parent in its bucket file.
+template <int K>
+class ExternalSearch {
+  enum : int { k = K, W = words_for(K) };
+
+  struct Record {
+    PackedBoard<W> board;
+    uint8_t dir;  // move that produced the board, NO_MOVE for the start
+
+    bool operator<(const Record &other) const {
+      for (int i = 0; i < W; i++) {
+        if (board.w[i] != other.board.w[i]) {
+          return board.w[i] < other.board.w[i];
+        }
+      }
+      return false;
+    }
+  };
+
+  enum : uint8_t { NO_MOVE = 4 };
+  enum : size_t { RECORD_BYTES = W * 8 + 1 };  // on disk, no padding
+
+  struct Bucket {
+    vector<string> runs;     // sorted, may overlap
+    vector<Record> pending;  // not written yet
+    string file;             // merged, set once the bucket was expanded
+    size_t records = 0;      // in file
+  };
+
+  string dir;
+  size_t budget;       // records buffered over all buckets, at most
+  size_t pending = 0;  // records buffered now
+  map<pair<int, int>, Bucket> buckets;
+  int files = 0;
+  size_t fan_in = 64;  // runs merged at once
+  long long explored = 0, expanded = 0, runs_written = 0;
+  string error;  // the first I/O failure, which ends the search
+
+  static bool write_record(FILE *out, const Record &r) {
+    return fwrite(r.board.w, 8, W, out) == (size_t)W &&
+           fwrite(&r.dir, 1, 1, out) == 1;
+  }
+
+  static bool read_record(FILE *in, Record &r) {
+    return fread(r.board.w, 8, W, in) == (size_t)W &&
+           fread(&r.dir, 1, 1, in) == 1;
+  }
+
+  string new_file() { return dir + "/" + to_string(files++) + ".bin"; }
+
+  // nullptr and the error set if path cannot be opened
+  FILE *open_file(const string &path, const char *mode) {
+    FILE *f = fopen(path.c_str(), mode);
+    if (!f && error.empty()) error = "Could not open " + path;
+    return f;
+  }
+
+  bool flush(Bucket &b) {
+    if (b.pending.empty()) return true;
+    sort(b.pending.begin(), b.pending.end());
+    string path = new_file();
+    FILE *out = open_file(path, "wb");
+    if (!out) return false;
+    b.runs.push_back(path);  // removed with the bucket even if incomplete
+    bool ok = true;
+    for (const Record &r : b.pending) {
+      if (!(ok = write_record(out, r))) break;
+    }
+    if (fclose(out) != 0 || !ok) {
+      error = "Could not write " + path;
+      return false;
+    }
+    runs_written++;
+    pending -= b.pending.size();
+    vector<Record>().swap(b.pending);  // clear() would keep the memory
+    return true;
+  }
+
+  bool add(int g, int h, const Record &r) {
+    Bucket &b = buckets[{g, h}];
+    b.pending.push_back(r);
+    pending++;
+    explored++;
+    if (pending < budget) return true;
+
+    Bucket *biggest = &b;
+    for (auto &entry : buckets) {
+      if (entry.second.pending.size() > biggest->pending.size()) {
+        biggest = &entry.second;
+      }
+    }
+    return flush(*biggest);
+  }
+
+  // merges sorted runs into the file out_path without duplicates and, if
+  // closed is not empty, without the boards in those merged files. the
+  // input runs are removed.
+  bool merge_runs(const vector<string> &paths, const vector<string> &closed,
+                  const string &out_path, size_t &records) {
+    vector<FILE *> runs, closed_in;
+    vector<Record> closed_cur;
+    FILE *out = nullptr;
+    bool ok = true;
+    for (const string &path : paths) {
+      runs.push_back(open_file(path, "rb"));
+      if (!runs.back()) ok = false;
+    }
+    for (const string &path : closed) {
+      closed_in.push_back(open_file(path, "rb"));
+      closed_cur.emplace_back();
+      if (!closed_in.back()) {
+        ok = false;
+      } else if (!read_record(closed_in.back(), closed_cur.back())) {
+        fclose(closed_in.back());
+        closed_in.back() = nullptr;
+      }
+    }
+    if (ok) ok = (out = open_file(out_path, "wb")) != nullptr;
+
+    typedef pair<Record, int> Item;
+    auto later = [](const Item &a, const Item &c) { return c.first < a.first; };
+    priority_queue<Item, vector<Item>, decltype(later)> heap(later);
+    for (int i = 0; ok && i < (int)runs.size(); i++) {
+      Record r;
+      if (read_record(runs[i], r)) heap.push({r, i});
+    }
+
+    bool have_last = false;
+    Record last;
+    records = 0;
+    while (ok && !heap.empty()) {
+      Item top = heap.top();
+      heap.pop();
+      Record next;
+      if (read_record(runs[top.second], next)) heap.push({next, top.second});
+
+      const Record &r = top.first;
+      if (have_last && !(last < r)) continue;
+      last = r;
+      have_last = true;
+
+      bool seen = false;
+      for (size_t c = 0; c < closed_in.size(); c++) {
+        while (closed_in[c] && closed_cur[c] < r) {
+          if (!read_record(closed_in[c], closed_cur[c])) {
+            fclose(closed_in[c]);
+            closed_in[c] = nullptr;
+          }
+        }
+        if (closed_in[c] && !(r < closed_cur[c])) seen = true;
+      }
+      if (seen) continue;
+
+      ok = write_record(out, r);
+      records++;
+    }
+
+    for (FILE *f : runs) {
+      if (f) fclose(f);
+    }
+    for (FILE *f : closed_in) {
+      if (f) fclose(f);
+    }
+    if (out && (fclose(out) != 0 || !ok) && error.empty()) {
+      error = "Could not write " + out_path;
+    }
+    if (!error.empty()) return false;
+    for (const string &path : paths) remove(path.c_str());
+    return true;
+  }
+
+  // merges the runs of (g, h) into one sorted file without duplicates or
+  // boards closed in (g - 1, h) and (g - 2, h). with more runs than can be
+  // open at once, groups of fan_in runs are merged into bigger runs first.
+  bool merge(int g, int h) {
+    Bucket &b = buckets[{g, h}];
+    if (!flush(b)) return false;
+
+    while (b.runs.size() > fan_in) {
+      vector<string> group(b.runs.begin(), b.runs.begin() + fan_in);
+      string path = new_file();
+      b.runs.push_back(path);
+      size_t records;
+      if (!merge_runs(group, {}, path, records)) return false;
+      b.runs.erase(b.runs.begin(), b.runs.begin() + fan_in);
+    }
+
+    vector<string> closed;
+    for (int back = 1; back <= 2; back++) {
+      auto it = buckets.find({g - back, h});
+      if (it != buckets.end() && !it->second.file.empty()) {
+        closed.push_back(it->second.file);
+      }
+    }
+    b.file = new_file();
+    if (!merge_runs(b.runs, closed, b.file, b.records)) return false;
+    b.runs.clear();
+    return true;
+  }
+
+  bool expand(int g, int h) {
+    Bucket &b = buckets[{g, h}];
+    FILE *in = open_file(b.file, "rb");
+    if (!in) return false;
+    Record r;
+
+    while (read_record(in, r)) {
+      expanded++;
+      int blank = 0;
+      while (r.board.get(blank)) blank++;
+
+      for (int d = 0; d < 4; d++) {
+        int from = geometry<K>.neighbor[blank][d];
+        if (from == -1) continue;
+        if (r.dir != NO_MOVE && d == (r.dir ^ 1)) continue;  // undoes r.dir
+
+        int tile = r.board.get(from);
+        int dh = geometry<K>.distance[tile][blank] -
+                 geometry<K>.distance[tile][from];
+
+        Record child = r;
+        child.board.set(blank, tile);
+        child.board.set(from, 0);
+        child.dir = d;
+        if (!add(g + 1, h + dh, child)) {
+          fclose(in);
+          return false;
+        }
+      }
+    }
+    fclose(in);
+    return true;
+  }
+
+  int manhattan(const PackedBoard<W> &board) const {
+    int dist = 0;
+    for (int pos = 0; pos < k * k; pos++) {
+      int tile = board.get(pos);
+      if (tile) dist += geometry<K>.distance[tile][pos];
+    }
+    return dist;
+  }
+
+  // binary search in a merged bucket file
+  bool find(const Bucket &b, const PackedBoard<W> &board, Record &found) {
+    FILE *in = open_file(b.file, "rb");
+    if (!in) return false;
+    size_t lo = 0, hi = b.records;
+    Record key{board, 0};
+    bool ok = false;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      fseek(in, mid * RECORD_BYTES, SEEK_SET);
+      read_record(in, found);
+      if (found < key) {
+        lo = mid + 1;
+      } else if (key < found) {
+        hi = mid;
+      } else {
+        ok = true;
+        break;
+      }
+    }
+    fclose(in);
+    return ok;
+  }
+
+  vector<int> tiles(const PackedBoard<W> &board) const {
+    vector<int> tiles(k * k);
+    for (int pos = 0; pos < k * k; pos++) tiles[pos] = board.get(pos);
+    return tiles;
+  }
+
+  // walks back from the goal at depth g by undoing each record's move
+  bool collect_path(int g, SearchResult &result) {
+    PackedBoard<W> board;
+    for (int pos = 0; pos < k * k; pos++) {
+      board.set(pos, pos == k * k - 1 ? 0 : pos + 1);
+    }
+
+    vector<vector<int>> path;
+    for (int depth = g;; depth--) {
+      Record r;
+      if (!find(buckets[{depth, manhattan(board)}], board, r)) {
+        if (error.empty()) error = "Lost the path at depth " + to_string(depth);
+        return false;
+      }
+      path.push_back(tiles(board));
+      if (r.dir == NO_MOVE) break;
+
+      int blank = 0;
+      while (board.get(blank)) blank++;
+      // the blank moved in r.dir, so the parent has it one step back
+      int prev = geometry<K>.neighbor[blank][r.dir ^ 1];
+      board.set(blank, board.get(prev));
+      board.set(prev, 0);
+    }
+
+    result.path.assign(path.rbegin(), path.rend());
+    return true;
+  }
+
+ public:
+  // memory_mb bounds the records buffered, over all buckets, before they
+  // are sorted and written. a vector can hold up to twice what it was
+  // filled with, so the budget is half of it
+  ExternalSearch(const string &parent_dir, size_t memory_mb) {
+    string templ = parent_dir + "/npuzzle-XXXXXX";
+    vector<char> name(templ.begin(), templ.end());
+    name.push_back('\0');
+    if (!mkdtemp(name.data())) {
+      error = "Could not create a directory in " + parent_dir;
+      return;
+    }
+    dir = name.data();
+    budget = max<size_t>(1, (memory_mb << 20) / 2 / sizeof(Record));
+
+    // a merge holds its runs, two closed files, its output and a file that
+    // is being flushed open at once, next to stdio and whatever else is open
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+        limit.rlim_cur < fan_in + 16) {
+      fan_in = limit.rlim_cur > 18 ? limit.rlim_cur - 16 : 2;
+    }
+  }
+
+  ~ExternalSearch() {
+    if (dir.empty()) return;
+    for (auto &entry : buckets) {
+      for (const string &path : entry.second.runs) remove(path.c_str());
+      if (!entry.second.file.empty()) remove(entry.second.file.c_str());
+    }
+    rmdir(dir.c_str());
+  }
+
+  // result.error is set if a file could not be created, written or read
+  SearchResult run(const Node<K> &start) {
+    SearchResult result;
+    bool ok = error.empty() &&
+              add(0, start.manhattan_dist, Record{start.board, NO_MOVE});
+
+    // f only changes by 0 or 2, so its parity never does
+    for (int f = start.manhattan_dist; ok && result.moves == -1; f += 2) {
+      for (int g = 0; ok && g <= f && result.moves == -1; g++) {
+        auto it = buckets.find({g, f - g});
+        if (it == buckets.end()) continue;
+
+        ok = merge(g, f - g);
+        if (!ok) break;
+        if (f - g == 0 && it->second.records) {
+          result.moves = g;
+          ok = collect_path(g, result);
+        } else {
+          ok = expand(g, f - g);
+        }
+      }
+    }
+
+    if (!ok) {
+      result.moves = -1;
+      result.path.clear();
+      result.error = error;
+    }
+    result.explored = explored;
+    result.expanded = expanded;
+    result.runs_written = runs_written;
+    return result;
+  }
+};
+
+string describe(const Options &opt) {
+  string h = heuristic_names[opt.heuristic];
+  if (opt.mode == IDA_STAR_MODE) return "IDA* with " + h;
+  if (opt.mode == BIDIRECTIONAL_MODE) {
+    return "bidirectional MM with Manhattan distance";
+  }
+  if (opt.mode == EXTERNAL_MODE) {
+    return "external memory A* with Manhattan distance";
+  }
+  if (opt.mode == HDA_STAR_MODE) {
+    return "HDA* (" + to_string(opt.threads) + " threads) with " + h;
+  }
+  if (opt.mode == ANYTIME_MODE) return "anytime weighted A* with " + h;
+  return h;
+}
+
+template <int K>
+SearchResult search(const vector<vector<int>> &grid, const Options &opt) {
+  Node<K> start(grid, opt.heuristic);
+
+  if (opt.mode == IDA_STAR_MODE) {
+    return IDA_star<K>(start, opt.heuristic).run();
+  }
+
+  if (opt.mode == HDA_STAR_MODE) {
+    return HDA_star<K>(opt.heuristic, opt.threads).run(start);
+  }
+
+  if (opt.mode == BIDIRECTIONAL_MODE) return Bidirectional<K>(start).run();
+
+  if (opt.mode == EXTERNAL_MODE) {
+    return ExternalSearch<K>(opt.external_dir, opt.memory_mb).run(start);
+  }
+
+  if (opt.mode == ANYTIME_MODE) {
+    // the batch workers share cout, the server answers on it and benchmark
+    // runs print a table, so only a single search reports progress
+    bool report = opt.batch.empty() && !opt.serve && !opt.bench;
+    return AnytimeSearch<K>(opt.heuristic, opt.weight, opt.weight_step,
+                            opt.time_limit, report ? &cout : nullptr)
+        .run(start);
+  }
+
+  double snapshot_interval = opt.stats ? opt.stats_interval : 0;
+  // the server answers one puzzle at a time, so it can keep a single A*
+  // memory per board size warm between them
+  AStarMemory<K> *memory = nullptr;
+  if (opt.serve) {
+    static AStarMemory<K> kept;
+    memory = &kept;
+  }
+
+  if (opt.bucket_queue) {
+    return A_star<K, BucketQueue<K>>(start, opt.heuristic, snapshot_interval,
+                                     memory);
+  }
+  return A_star<K, priority_queue<uint32_t, vector<uint32_t>, Compare<K>>>(
+      start, opt.heuristic, snapshot_interval, memory);
+}
+
+// the --stats report, a JSON object in place of print_result. the open
+// size, boards generated, heuristic counts, time split and snapshots are
+// only there for A*, the other searches report the counters and totals, and
+// --external the sorted runs it wrote.
+void print_stats(const SearchResult &result, const Options &opt, int k,
+                 double seconds) {
+  const SearchStats &stats = result.stats;
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  cout << fixed << setprecision(6);
+  cout << "{\n";
+  cout << "  \"search\": \"" << describe(opt) << "\",\n";
+  cout << "  \"k\": " << k << ",\n";
+  cout << "  \"moves\": " << result.moves << ",\n";
+  cout << "  \"bound\": " << result.bound << ",\n";
+  cout << "  \"explored\": " << result.explored << ",\n";
+  cout << "  \"expanded\": " << result.expanded << ",\n";
+  cout << "  \"seconds\": " << seconds << ",\n";
+  cout << "  \"nodes_per_second\": "
+       << (seconds > 0 ? result.expanded / seconds : 0) << ",\n";
+  // kilobytes on linux
+  cout << "  \"peak_rss_kb\": " << usage.ru_maxrss;
+  if (opt.mode == EXTERNAL_MODE) {
+    cout << ",\n  \"runs_written\": " << result.runs_written;
+  }
+
+  if (stats.collected) {
+    cout << ",\n";
+    cout << "  \"peak_open\": " << stats.peak_open << ",\n";
+    cout << "  \"generated_states\": " << stats.generated_states << ",\n";
+    cout << "  \"heuristic_evaluations\": " << stats.heuristic_evaluations
+         << ",\n";
+    cout << "  \"time\": {\"expansion\": "
+         << stats.seconds[SearchStats::EXPANSION]
+         << ", \"heuristic\": " << stats.seconds[SearchStats::HEURISTIC]
+         << ", \"queue\": " << stats.seconds[SearchStats::QUEUE] << "},\n";
+    cout << "  \"snapshots\": [";
+    for (size_t i = 0; i < stats.snapshots.size(); i++) {
+      const SearchStats::Snapshot &s = stats.snapshots[i];
+      cout << (i ? ",\n    " : "\n    ") << "{\"seconds\": " << s.seconds
+           << ", \"explored\": " << s.explored
+           << ", \"expanded\": " << s.expanded << ", \"open\": " << s.open
+           << ", \"generated\": " << s.generated << ", \"min_f\": " << s.min_f
+           << "}";
+    }
+    cout << (stats.snapshots.empty() ? "]" : "\n  ]");
+  }
+  cout << "\n}\n";
+}
+
+// the board must be solvable and its size supported
+SearchResult solve(const vector<vector<int>> &grid, const Options &opt) {
+  switch (grid.size()) {
+    case 1:
+      return search<1>(grid, opt);
+    case 2:
+      return search<2>(grid, opt);
+    case 3:
+      return search<3>(grid, opt);
+    case 4:
+      return search<4>(grid, opt);
+    case 5:
+      return search<5>(grid, opt);
+    case 6:
+      return search<6>(grid, opt);
+    case 7:
+      return search<7>(grid, opt);
+    default:
+      return search<8>(grid, opt);
+  }
+}
+
+// reads k and the k x k board, false if it is not a permutation of
+// 0 .. k * k - 1
+bool read_puzzle(istream &in, vector<vector<int>> &grid) {
+  int k;
+  if (!(in >> k) || k <= 0) return false;
+
+  grid.assign(k, vector<int>(k, 0));
+  for (int i = 0; i < k; i++) {
+    for (int j = 0; j < k; j++) {
+      if (!(in >> grid[i][j])) return false;
+    }
+  }
+
+  // checked once the whole board is read, so that a stream of puzzles
+  // carries on with the next one
+  vector<bool> seen(k * k);
+  for (int i = 0; i < k; i++) {
+    for (int j = 0; j < k; j++) {
+      int tile = grid[i][j];
+      if (tile < 0 || tile >= k * k || seen[tile]) return false;
+      seen[tile] = true;
+    }
+  }
+  return true;
+}
+
+int blank_row(const vector<vector<int>> &grid) {
+  for (int i = 0; i < (int)grid.size(); i++) {
+    for (int tile : grid[i]) {
+      if (!tile) return i;
+    }
+  }
+  return 0;
+}
+
+// the move count in an expected output file, -1 for "Unsolvable puzzle" and
+// -2 if the file is missing or unreadable
+int read_expected(const string &path) {
+  ifstream in(path);
+  string line;
+  while (getline(in, line)) {
+    if (line.find("Unsolvable") != string::npos) return -1;
+    if (line.find("Minimum number of moves =") != string::npos) {
+      return atoi(line.c_str() + line.find('=') + 1);
+    }
+  }
+  return -2;
+}
+
+// inNN.txt -> outNN.txt, 1_in.txt -> 1_out.txt
+string expected_path(const string &path) {
+  size_t slash = path.rfind('/');
+  size_t base = slash == string::npos ? 0 : slash + 1;
+  size_t in = path.find("in", base);
+  if (in == string::npos) return "";
+  return path.substr(0, in) + "out" + path.substr(in + 2);
+}
+
+// every file in dir whose name has "in" but not "out" in it, or for a
+// manifest every line as "instance<tab>expected output" (paths may have
+// spaces, the expected output is optional)
+bool list_instances(const string &path,
+                    vector<pair<string, string>> &instances) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return false;
+
+  if (S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(path.c_str());
+    if (!dir) return false;
+    vector<string> names;
+    while (dirent *entry = readdir(dir)) {
+      string name = entry->d_name;
+      if (name.find("in") != string::npos &&
+          name.find("out") == string::npos) {
+        names.push_back(name);
+      }
+    }
+    closedir(dir);
+    sort(names.begin(), names.end());
+    for (const string &name : names) {
+      string file = path + "/" + name;
+      instances.emplace_back(file, expected_path(file));
+    }
+    return true;
+  }
+
+  ifstream in(path);
+  string line;
+  while (getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    size_t tab = line.find('\t');
+    string file = line.substr(0, tab);
+    string expected =
+        tab == string::npos ? expected_path(file) : line.substr(tab + 1);
+    instances.emplace_back(file, expected);
+  }
+  return true;
+}
+
+// solves every instance on a pool of opt.jobs threads and prints one line
+// per instance as it finishes, then a total
+int run_batch(const Options &opt) {
+  vector<pair<string, string>> instances;
+  if (!list_instances(opt.batch, instances)) {
+    cerr << "Could not read " << opt.batch << "\n";
+    return 1;
+  }
+
+  // pattern databases are built up front, the workers only read them. a
+  // size whose database cannot be opened fails its instances, not the run
+  vector<vector<vector<int>>> grids(instances.size());
+  vector<bool> readable(instances.size()), no_pdb(instances.size());
+  int opened[9] = {};  // per k: 1 opened, -1 failed
+  for (size_t i = 0; i < instances.size(); i++) {
+    ifstream in(instances[i].first);
+    readable[i] = read_puzzle(in, grids[i]);
+    int k = grids[i].size();
+    if (readable[i] && opt.heuristic == 3 && words_for(k) && k >= 2) {
+      if (!opened[k]) opened[k] = open_pattern_database(k, opt) ? 1 : -1;
+      no_pdb[i] = opened[k] < 0;
+    }
+  }
+
+  atomic<size_t> next{0};
+  atomic<int> passed{0}, failed{0}, bounded{0}, unchecked{0};
+  mutex out_lock;
+
+  auto worker = [&]() {
+    for (size_t i; (i = next++) < instances.size();) {
+      const vector<vector<int>> &grid = grids[i];
+      int k = grid.size();
+      int expected = instances[i].second.empty()
+                         ? -2
+                         : read_expected(instances[i].second);
+
+      stringstream line;
+      line << instances[i].first;
+
+      int moves = -2;
+      double bound = 1;
+      bool timed_out = false, error = false;
+      if (!readable[i]) {
+        line << " unreadable";
+      } else if (!solvable(grid, blank_row(grid))) {
+        moves = -1;
+        line << " k=" << k << " unsolvable";
+      } else if (!words_for(k)) {
+        line << " k=" << k << " unsupported";
+      } else if (no_pdb[i]) {
+        error = true;
+        line << " k=" << k << " no pattern database";
+      } else {
+        auto begin = chrono::steady_clock::now();
+        SearchResult result = solve(grid, opt);
+        double secs = chrono::duration<double>(chrono::steady_clock::now() -
+                                               begin)
+                          .count();
+        moves = result.moves;
+        bound = result.bound;
+        // the anytime search gives up at its time limit
+        timed_out = moves == -1 && opt.mode == ANYTIME_MODE;
+        error = !result.error.empty();
+        line << " k=" << k;
+        if (error) {
+          line << " " << result.error;
+        } else {
+          line << " moves=" << moves << " time=" << fixed << setprecision(3)
+               << secs << "s expanded=" << result.expanded;
+        }
+      }
+
+      // a path not proven shortest only has to be within its bound
+      if (error) {
+        line << " FAILED";
+        failed++;
+      } else if (expected == -2) {
+        line << " UNCHECKED";
+        unchecked++;
+      } else if (timed_out) {
+        line << " UNCHECKED no path in time";
+        unchecked++;
+      } else if (moves == expected) {
+        line << " OK";
+        passed++;
+      } else if (bound > 1 && expected >= 0 && moves >= expected &&
+                 moves <= bound * expected) {
+        line << " BOUNDED (<= " << setprecision(2) << bound
+             << " x optimal) expected=" << expected;
+        bounded++;
+      } else {
+        line << " MISMATCH expected="
+             << (expected == -1 ? string("unsolvable") : to_string(expected));
+        failed++;
+      }
+
+      lock_guard<mutex> lock(out_lock);
+      cout << line.str() << endl;
+    }
+  };
+
+  vector<thread> pool;
+  for (int i = 0; i < opt.jobs; i++) pool.emplace_back(worker);
+  for (thread &t : pool) t.join();
+
+  cout << "Total " << instances.size() << ": " << passed << " ok, "
+       << bounded << " bounded, " << failed << " mismatched or failed, "
+       << unchecked << " unchecked\n";
+  return failed ? 1 : 0;
+}
+
+// a seeded, solvable k x k board. depth > 0 scrambles the goal with that
+// many random moves, never undoing the previous one, so the board is at most
+// depth moves from the goal; depth 0 draws random permutations until one
+// passes the parity check.
+vector<vector<int>> scrambled_board(int k, int depth, mt19937 &rng) {
+  vector<int> tiles(k * k);
+  for (int pos = 0; pos < k * k; pos++) tiles[pos] = (pos + 1) % (k * k);
+  vector<vector<int>> grid(k, vector<int>(k));
+  auto to_grid = [&]() {
+    for (int pos = 0; pos < k * k; pos++) grid[pos / k][pos % k] = tiles[pos];
+  };
+
+  if (!depth) {
+    do {
+      shuffle(tiles.begin(), tiles.end(), rng);
+      to_grid();
+    } while (!solvable(grid, blank_row(grid)));
+    return grid;
+  }
+
+  int zr = k - 1, zc = k - 1, prev = -1;
+  for (int step = 0; step < depth && k > 1; step++) {
+    int dirs[4], n = 0;
+    for (int dir = 0; dir < 4; dir++) {
+      if (valid(zr, zc, dir, k, k) && dir != (prev ^ 1)) dirs[n++] = dir;
+    }
+    int dir = dirs[rng() % n];
+    int nr = zr + (dir == 2 ? -1 : dir == 3 ? 1 : 0);
+    int nc = zc + (dir == 0 ? -1 : dir == 1 ? 1 : 0);
+    swap(tiles[zr * k + zc], tiles[nr * k + nc]);
+    zr = nr;
+    zc = nc;
+    prev = dir;
+  }
+  to_grid();
+  assert(solvable(grid, zr));
+  return grid;
+}
+
+// sets the mode and heuristic of a benchmark solver name, "mode" or
+// "mode:heuristic" as listed by --bench-solvers
+bool apply_solver(const string &name, Options &opt) {
+  size_t colon = name.find(':');
+  string mode = name.substr(0, colon);
+  string h = colon == string::npos ? "manhattan" : name.substr(colon + 1);
+
+  opt.bucket_queue = mode == "astar-buckets";
+  if (mode == "astar" || mode == "astar-buckets") {
+    opt.mode = A_STAR_MODE;
+  } else if (mode == "ida") {
+    opt.mode = IDA_STAR_MODE;
+  } else if (mode == "hda") {
+    opt.mode = HDA_STAR_MODE;
+  } else if (mode == "bidirectional") {
+    opt.mode = BIDIRECTIONAL_MODE;
+  } else if (mode == "external") {
+    opt.mode = EXTERNAL_MODE;
+  } else if (mode == "anytime") {
+    opt.mode = ANYTIME_MODE;
+  } else {
+    return false;
+  }
+
+  opt.heuristic = h == "hamming"     ? 0
+                  : h == "manhattan" ? 1
+                  : h == "linear"    ? 2
+                  : h == "pdb"       ? 3
+                                     : -1;
+  return opt.heuristic != -1;
+}
+
+struct BenchRun {
+  bool done = false;  // false if it failed or ran out of time
+  int moves = -1;
+  double bound = 1, seconds = 0;
+  long long expanded = 0;
+  long rss_kb = 0;
+};
+
+// solves one board in a child process, so that its peak memory can be read
+// on its own and a run over the time limit can be killed
+BenchRun bench_run(const vector<vector<int>> &grid, const Options &opt) {
+  BenchRun run;
+  int fds[2];
+  if (pipe(fds) == -1) return run;
+  cout.flush();
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    alarm(opt.bench_timeout);
+    auto begin = chrono::steady_clock::now();
+    SearchResult result = solve(grid, opt);
+    run.seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    run.done = result.error.empty();
+    if (!run.done) cerr << result.error << "\n";
+    run.moves = result.moves;
+    run.bound = result.bound;
+    run.expanded = result.expanded;
+    _exit(write(fds[1], &run, sizeof(run)) == sizeof(run) ? 0 : 1);
+  }
+
+  close(fds[1]);
+  if (pid != -1) {
+    if (read(fds[0], &run, sizeof(run)) != sizeof(run)) run.done = false;
+    int status;
+    rusage usage;
+    wait4(pid, &status, 0, &usage);
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) run.done = false;
+    run.rss_kb = usage.ru_maxrss;
+  }
+  close(fds[0]);
+  return run;
+}
+
+double median(vector<double> values) {
+  if (values.empty()) return 0;
+  sort(values.begin(), values.end());
+  size_t n = values.size();
+  return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// runs every solver on opt.bench_count seeded boards per class and prints a
+// line per class and solver: runs finished in time, then the median time,
+// nodes expanded per second and peak memory, and the largest peak memory.
+// solvers that prove optimality are checked against each other.
+int run_bench(const Options &opt) {
+  vector<pair<int, int>> classes;  // (k, depth)
+  stringstream class_list(opt.bench_classes);
+  for (string spec; getline(class_list, spec, ',');) {
+    int k = 0, depth = -1;
+    char colon = 0;
+    stringstream(spec) >> k >> colon >> depth;
+    if (k < 1 || !words_for(k) || colon != ':' || depth < 0) {
+      cerr << "Invalid instance class: " << spec << "\n";
+      return 1;
+    }
+    classes.push_back({k, depth});
+  }
+
+  vector<string> solvers;
+  stringstream solver_list(opt.bench_solvers);
+  for (string name; getline(solver_list, name, ',');) {
+    Options check = opt;
+    if (!apply_solver(name, check)) {
+      cerr << "Unknown solver: " << name << "\n";
+      return 1;
+    }
+    solvers.push_back(name);
+  }
+
+  cout << left << setw(14) << "class" << setw(22) << "solver" << right
+       << setw(8) << "done" << setw(12) << "median ms" << setw(14)
+       << "nodes/s" << setw(11) << "median MB" << setw(9) << "max MB"
+       << "\n";
+
+  int mismatches = 0;
+  for (pair<int, int> c : classes) {
+    int k = c.first, depth = c.second;
+    string label = to_string(k) + "x" + to_string(k) + " " +
+                   (depth ? "d" + to_string(depth) : string("random"));
+
+    // seeded per class, so adding a class leaves the others' boards alone
+    mt19937 rng(opt.bench_seed * 1000003u + k * 1009u + depth);
+    vector<vector<vector<int>>> boards;
+    for (int i = 0; i < opt.bench_count; i++) {
+      boards.push_back(scrambled_board(k, depth, rng));
+    }
+    vector<int> optimal(boards.size(), -1);
+
+    for (const string &name : solvers) {
+      Options run_opt = opt;
+      apply_solver(name, run_opt);
+      // built or mapped here, so every child shares the mapping
+      if (run_opt.heuristic == 3 &&
+          (k < 2 || !open_pattern_database(k, run_opt))) {
+        cout << left << setw(14) << label << setw(22) << name
+             << "no pattern database\n";
+        continue;
+      }
+
+      int done = 0;
+      vector<double> ms, rate, mb;
+      double max_mb = 0;
+      for (size_t i = 0; i < boards.size(); i++) {
+        BenchRun run = bench_run(boards[i], run_opt);
+        max_mb = max(max_mb, run.rss_kb / 1024.0);
+        if (!run.done) continue;
+        done++;
+        ms.push_back(run.seconds * 1000);
+        rate.push_back(run.seconds > 0 ? run.expanded / run.seconds : 0);
+        mb.push_back(run.rss_kb / 1024.0);
+
+        if (run.bound > 1 || run.moves == -1) continue;
+        if (optimal[i] == -1) optimal[i] = run.moves;
+        if (optimal[i] != run.moves) {
+          cout << label << " board " << i << ": " << name << " found "
+               << run.moves << " moves, expected " << optimal[i] << "\n";
+          mismatches++;
+        }
+      }
+
+      cout << left << setw(14) << label << setw(22) << name << right
+           << setw(8) << (to_string(done) + "/" + to_string(boards.size()))
+           << fixed << setprecision(2) << setw(12) << median(ms)
+           << setprecision(0) << setw(14) << median(rate) << setprecision(1)
+           << setw(11) << median(mb) << setw(9) << max_mb << defaultfloat
+           << endl;
+    }
+  }
+  return mismatches ? 1 : 0;
+}
+
+// stream buffer over a connected socket, for the server's clients
+class SocketBuf : public streambuf {
+  int fd;
+  char in[4096], out[4096];
+
+ protected:
+  int underflow() override {
+    ssize_t n;
+    do {
+      n = read(fd, in, sizeof(in));
+    } while (n == -1 && errno == EINTR);
+    if (n <= 0) return traits_type::eof();
+    setg(in, in, in + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  int overflow(int c) override {
+    if (sync() == -1) return traits_type::eof();
+    if (c != traits_type::eof()) {
+      *pptr() = c;
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override {
+    for (char *p = pbase(); p < pptr();) {
+      // MSG_NOSIGNAL: a client that hung up is an error, not a SIGPIPE
+      ssize_t n = send(fd, p, pptr() - p, MSG_NOSIGNAL);
+      if (n == -1 && errno == EINTR) continue;
+      if (n <= 0) return -1;
+      p += n;
+    }
+    setp(out, out + sizeof(out));
+    return 0;
+  }
+
+ public:
+  SocketBuf(int fd) : fd(fd) {
+    setg(in, in, in);
+    setp(out, out + sizeof(out));
+  }
+};
+
+// answers every puzzle read from in, in the input format, until it ends. an
+// answer is the move count and then the boards of the path, one row-major
+// board per line, or one of unsolvable, unsupported, invalid or error; it
+// ends with an empty line.
+void serve(istream &in, ostream &out, const Options &opt) {
+  vector<vector<int>> grid;
+  while (true) {
+    if (!read_puzzle(in, grid)) {
+      if (in.eof()) return;
+      out << "invalid\n\n" << flush;
+      // after a token that is not a number the stream cannot be resynced
+      if (!in) return;
+      continue;
+    }
+
+    int k = grid.size();
+    if (!solvable(grid, blank_row(grid))) {
+      out << "unsolvable\n";
+    } else if (!words_for(k)) {
+      out << "unsupported\n";
+    } else if (opt.heuristic == 3 &&
+               (k < 2 || !open_pattern_database(k, opt))) {
+      out << "error\n";
+    } else {
+      SearchResult result = solve(grid, opt);
+      if (!result.error.empty()) {
+        cerr << result.error << "\n";
+        out << "error\n\n" << flush;
+        continue;
+      }
+      out << result.moves << "\n";
+      for (const vector<int> &tiles : result.path) {
+        for (size_t i = 0; i < tiles.size(); i++) {
+          out << (i ? " " : "") << tiles[i];
+        }
+        out << "\n";
+      }
+    }
+    out << "\n" << flush;
+  }
+}
+
+// serves stdin, or every client of the unix socket one after another
+int run_server(const Options &opt) {
+  if (opt.socket_path.empty()) {
+    serve(cin, cout, opt);
+    return 0;
+  }
+
+  const string &path = opt.socket_path;
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    cerr << "Socket path too long: " << path << "\n";
+    return 1;
+  }
+  strcpy(addr.sun_path, path.c_str());
+
+  // a socket left behind by an earlier server, never any other file
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    unlink(path.c_str());
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1 || bind(fd, (sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(fd, 16) == -1) {
+    cerr << "Could not listen on " << path << "\n";
+    return 1;
+  }
+  cerr << "Listening on " << path << "\n";
+
+  while (true) {
+    int client = accept(fd, nullptr, nullptr);
+    if (client == -1) {
+      if (errno == EINTR) continue;
+      cerr << "Could not accept a client on " << path << "\n";
+      return 1;
+    }
+    SocketBuf buf(client);
+    istream in(&buf);
+    ostream out(&buf);
+    serve(in, out, opt);
+    close(client);
+  }
+}
+
+/*
+    g++ -std=c++14 -O3 -pthread main.cpp -o main
+    ./main [--ida | --hda | --bidirectional | --external | --anytime]
+           [--threads n] [--buckets] [--external-dir dir] [--memory mb]
+           [--weight w] [--weight-step s] [--time-limit secs]
+           [--stats [--stats-interval secs]]
+           [--heuristic hamming|manhattan|linear|pdb]
+           [--pdb file] [--pdb-partition sizes] < input.txt
+    ./main --batch dir|manifest [--jobs n] [options above]
+    ./main --serve [--socket path] [options above]
+    ./main --bench [--bench-classes k:depth,...] [--bench-solvers names]
+           [--bench-count n] [--bench-seed s] [--bench-timeout secs]
+           [options above]
+
+    --ida             solve with IDA* instead of A*
+    --hda             solve with hash distributed A* on several threads
+    --bidirectional   solve with bidirectional MM (manhattan distance only)
+    --external        solve with external memory A*, keeping the search in
+                      sorted files on disk (manhattan distance only)
+    --external-dir    where --external keeps its files, $TMPDIR or /tmp
+    --memory          megabytes --external buffers over all its buckets
+                      before writing a run, 256 by default
+    --anytime         solve with anytime repairing A*: a first path from
+                      weighted A*, then shorter ones as the weight drops,
+                      each with a proven bound on how far from the minimum
+                      it can be, until --time-limit seconds (1 by default)
+    --weight          starting heuristic weight for --anytime, 3 by default
+    --weight-step     how much the weight drops per pass, 0.5 by default
+    --threads         threads for --hda, all cores by default, or 1 in
+                      batch mode, where the instances run in parallel
+    --stats           print search statistics as JSON instead of the path:
+                      nodes per second, peak memory and, for A*, the peak
+                      open size, distinct boards generated (expanded counts
+                      the closed ones), heuristic evaluations, the time
+                      split between expansion, heuristic and queue work and
+                      frontier snapshots. timing each step slows A* down
+    --stats-interval  seconds between frontier snapshots, 1 by default
+    --serve           keep running and answer every puzzle read from stdin,
+                      keeping the A* memory and pattern databases loaded
+                      between them. each answer is the move count and the
+                      path, one board per line, followed by an empty line
+    --socket          serve the clients of this unix socket one at a time
+                      instead of stdin
+    --bench           time every solver on seeded boards and print the
+                      median time, nodes per second and peak memory per
+                      board class. each run is a child process
+    --bench-classes   board classes as k:depth, scrambled with depth random
+                      moves from the goal or, for depth 0, uniformly random
+                      solvable boards. 3:0,4:30,4:45,5:40 by default
+    --bench-solvers   mode[:heuristic] list, modes astar, astar-buckets,
+                      ida, hda, bidirectional, external and anytime. every
+                      mode and every heuristic but pdb by default
+    --bench-count     boards per class, 10 by default
+    --bench-seed      seed of the boards, 1 by default
+    --bench-timeout   seconds before a run is killed, 60 by default
+    --buckets         A* open list as buckets per (f, g) instead of a heap
+    --heuristic       hamming, manhattan (default), linear (manhattan plus
+                      linear conflicts) or pdb (additive pattern database)
+    --pdb             pattern database file, pdb<k>.bin by default. it is
+                      built and saved first if it does not exist. boards of
+                      another size use their default file
+    --pdb-partition   pattern sizes for a new database, e.g. 6-6-3 or 7-8
+                      for 4x4. tiles are assigned to patterns in order.
+                      boards it does not fit use the default partition
+    --batch           solve every inNN.txt in a directory (or every file
+                      listed in a manifest, one "instance<tab>expected" per
+                      line) and check the move counts against outNN.txt.
+                      an anytime path passes as BOUNDED if it is within
+                      its proven bound of the expected count
+    --jobs            instances solved at once in batch mode, all cores
+                      divided by --threads by default
+*/
+int main(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--ida") {
+      opt.mode = IDA_STAR_MODE;
+    } else if (arg == "--hda") {
+      opt.mode = HDA_STAR_MODE;
+    } else if (arg == "--bidirectional") {
+      opt.mode = BIDIRECTIONAL_MODE;
+    } else if (arg == "--anytime") {
+      opt.mode = ANYTIME_MODE;
+    } else if (arg == "--weight" && i + 1 < argc) {
+      opt.weight = max(1.0, atof(argv[++i]));
+    } else if (arg == "--weight-step" && i + 1 < argc) {
+      opt.weight_step = max(0.01, atof(argv[++i]));
+    } else if (arg == "--time-limit" && i + 1 < argc) {
+      opt.time_limit = atof(argv[++i]);
+    } else if (arg == "--stats") {
+      opt.stats = true;
+    } else if (arg == "--stats-interval" && i + 1 < argc) {
+      opt.stats_interval = max(0.001, atof(argv[++i]));
+    } else if (arg == "--serve") {
+      opt.serve = true;
+    } else if (arg == "--socket" && i + 1 < argc) {
+      opt.serve = true;
+      opt.socket_path = argv[++i];
+    } else if (arg == "--bench") {
+      opt.bench = true;
+    } else if (arg == "--bench-classes" && i + 1 < argc) {
+      opt.bench_classes = argv[++i];
+    } else if (arg == "--bench-solvers" && i + 1 < argc) {
+      opt.bench_solvers = argv[++i];
+    } else if (arg == "--bench-count" && i + 1 < argc) {
+      opt.bench_count = max(1, atoi(argv[++i]));
+    } else if (arg == "--bench-seed" && i + 1 < argc) {
+      opt.bench_seed = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--bench-timeout" && i + 1 < argc) {
+      opt.bench_timeout = max(1, atoi(argv[++i]));
+    } else if (arg == "--external") {
+      opt.mode = EXTERNAL_MODE;
+    } else if (arg == "--external-dir" && i + 1 < argc) {
+      opt.external_dir = argv[++i];
+    } else if (arg == "--memory" && i + 1 < argc) {
+      opt.memory_mb = max(1, atoi(argv[++i]));
+    } else if (arg == "--threads" && i + 1 < argc) {
+      opt.threads = min(max(1, atoi(argv[++i])), (int)INT16_MAX);
+    } else if (arg == "--buckets") {
+      opt.bucket_queue = true;
+    } else if (arg == "--heuristic" && i + 1 < argc) {
+      string name = argv[++i];
+      opt.heuristic = name == "hamming"     ? 0
+                      : name == "manhattan" ? 1
+                      : name == "linear"    ? 2
+                      : name == "pdb"       ? 3
+                                            : -1;
+      if (opt.heuristic == -1) {
+        cerr << "Unknown heuristic: " << name << "\n";
+        return 1;
+      }
+    } else if (arg == "--batch" && i + 1 < argc) {
+      opt.batch = argv[++i];
+    } else if (arg == "--jobs" && i + 1 < argc) {
+      opt.jobs = max(1, atoi(argv[++i]));
+    } else if (arg == "--pdb" && i + 1 < argc) {
+      opt.pdb_path = argv[++i];
+    } else if (arg == "--pdb-partition" && i + 1 < argc) {
+      opt.pdb_partition = argv[++i];
+    } else {
+      cerr << "Usage: ./main "
+              "[--ida | --hda | --bidirectional | --external | --anytime] "
+              "[--threads n] [--buckets] [--external-dir dir] [--memory mb] "
+              "[--weight w] [--weight-step s] [--time-limit secs] "
+              "[--stats [--stats-interval secs]] "
+              "[--serve [--socket path]] "
+              "[--bench [--bench-classes k:depth,...] [--bench-solvers names] "
+              "[--bench-count n] [--bench-seed s] [--bench-timeout secs]] "
+              "[--heuristic hamming|manhattan|linear|pdb] "
+              "[--pdb file] [--pdb-partition sizes] "
+              "[--batch dir|manifest] [--jobs n] < input.txt\n";
+      return 1;
+    }
+  }
+
+  // each batch job runs its own HDA* threads, so jobs * threads is kept
+  // within the cores unless both are given
+  int cores = max(1u, thread::hardware_concurrency());
+  if (!opt.batch.empty()) {
+    if (!opt.threads) opt.threads = 1;
+    if (!opt.jobs) opt.jobs = max(1, cores / opt.threads);
+  }
+  if (!opt.threads) opt.threads = cores;
+
+  if (!opt.batch.empty()) return run_batch(opt);
+  if (opt.serve) return run_server(opt);
+  if (opt.bench) return run_bench(opt);
+
+  vector<vector<int>> grid;
+  if (!read_puzzle(cin, grid)) {
+    cerr << "Invalid puzzle\n";
+    return 1;
+  }
+  int k = grid.size();
+
+  if (!solvable(grid, blank_row(grid))) {
+    cout << "Not solvable\n";
+    return 0;
+  }
+
+  if (!words_for(k)) {
+    cerr << "Board size not supported\n";
+    return 0;
+  }
+
+  if (opt.heuristic == 3 && k < 2) {
+    cerr << "No pattern database for 1x1 boards\n";
+    return 1;
+  }
+  if (opt.heuristic == 3 && !open_pattern_database(k, opt)) return 1;
+
+  if (opt.stats) {
+    auto begin = chrono::steady_clock::now();
+    SearchResult result = solve(grid, opt);
+    double secs =
+        chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    if (!result.error.empty()) {
+      cerr << result.error << "\n";
+      return 1;
+    }
+    print_stats(result, opt, k, secs);
+    return 0;
+  }
+
+  cout << "Using " << describe(opt) << "\n";
+  SearchResult result = solve(grid, opt);
+  if (!result.error.empty()) {
+    cerr << result.error << "\n";
+    return 1;
+  }
+  print_result(result, k);
+}